@@ -0,0 +1,324 @@
+/******************************************************************************
+NAME: ascii_parser
+FUNCTION: Parallel parser of the ASCII data file. The file is mapped in
+memory, the header line is skipped and the rest is split in chunks at
+line boundaries that the threads parse independently with a fast number
+parser, storing every line straight into the grid at the cell given by
+its GID. When the grid holds only some columns, the file (one line per
+cell in C order) is parsed from the first line of those columns to the
+last one. The columns are the ones read by read_data_cells: GID, x, y, z,
+five dummy columns, potDot_r, potDot_r_l_app1 and potDot_r_l_app2.
+INPUT: ASCII data file
+RETURN: Grid filled
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: read_threads
+FUNCTION: Threads of the parallel readers (ASCII parser and decompression): all
+of them, or NREADTHREADS when a reader runs next to a sweep
+INPUT: None
+RETURN: number of threads
+*************************************************************************************/
+int read_threads(void)
+{
+  int nthreads;
+
+  nthreads = 1;
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  if( NREADTHREADS > 0 && NREADTHREADS < nthreads )
+    nthreads = NREADTHREADS;
+
+  return nthreads;
+}//read_threads
+
+
+
+/*************************************************************************************
+NAME: ascii_parse_double
+FUNCTION: Parses one number at *p, skipping the blanks before it. Numbers with
+at most 19 significant digits and a decimal exponent within +-22 are exactly
+representable as mantissa and power of ten, so one multiplication or division
+gives the correctly rounded value; any other token goes through strtod, which
+must take all of it.
+INPUT: position in the text (advanced past the number), end of the text, value
+RETURN: 0, 1 if there is no number before the end of the line, 2 if the token
+is not a number
+*************************************************************************************/
+int ascii_parse_double(char **p, char *end, double *value)
+{
+  static const double pow10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+				   1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+				   1e20, 1e21, 1e22};
+  char *s, *start, *tail, token[100];
+  unsigned long long int mant;
+  int ndigits, nmant, nexpo, exp10, expo, negative, expneg;
+  size_t len;
+
+  s = *p;
+  while( s < end && (*s == ' ' || *s == '\t' || *s == '\r') )
+    s++;
+  if( s == end || *s == '\n' )
+    return 1;
+
+  start = s;
+  negative = 0;
+  if( *s == '-' || *s == '+' )
+    {
+      negative = (*s == '-');
+      s++;
+    }//if
+
+  /*+++ Mantissa +++*/
+  mant = 0;
+  ndigits = 0;
+  nmant = 0;
+  exp10 = 0;
+  while( s < end && *s >= '0' && *s <= '9' )
+    {
+      if( mant != 0 || *s != '0' )
+	ndigits++;
+      mant = 10*mant + (unsigned long long int) (*s - '0');
+      nmant++;
+      s++;
+    }//while
+  if( s < end && *s == '.' )
+    {
+      s++;
+      while( s < end && *s >= '0' && *s <= '9' )
+	{
+	  if( mant != 0 || *s != '0' )
+	    ndigits++;
+	  mant = 10*mant + (unsigned long long int) (*s - '0');
+	  nmant++;
+	  exp10--;
+	  s++;
+	}//while
+    }//if
+
+  /*+++ Exponent +++*/
+  nexpo = 1;
+  if( s < end && (*s == 'e' || *s == 'E') )
+    {
+      s++;
+      expneg = 0;
+      if( s < end && (*s == '-' || *s == '+') )
+	{
+	  expneg = (*s == '-');
+	  s++;
+	}//if
+      expo = 0;
+      nexpo = 0;
+      while( s < end && *s >= '0' && *s <= '9' )
+	{
+	  if( expo < 10000 )
+	    expo = 10*expo + (*s - '0');
+	  nexpo++;
+	  s++;
+	}//while
+      exp10 += expneg ? -expo : expo;
+    }//if
+
+  /*+++ Fast path, digits in the mantissa and in the exponent if there is one +++*/
+  if( nmant > 0 && nexpo > 0 && ndigits <= 19 && mant <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22 &&
+      (s == end || *s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') )
+    {
+      *value = (double) mant;
+      *value = exp10 < 0 ? *value/pow10[-exp10] : *value*pow10[exp10];
+      if( negative )
+	*value = -*value;
+      *p = s;
+      return 0;
+    }//if
+
+  /*+++ Anything else (long mantissas, large exponents, nan, inf, malformed tokens) +++*/
+  s = start;
+  while( s < end && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n' )
+    s++;
+  len = (size_t) (s - start);
+  if( len >= sizeof(token) )
+    len = sizeof(token) - 1;
+  memcpy(token, start, len);
+  token[len] = '\0';
+  *value = strtod(token, &tail);
+  if( tail == token || *tail != '\0' )
+    return 2;
+  *p = s;
+
+  return 0;
+}//ascii_parse_double
+
+
+
+/*************************************************************************************
+NAME: ascii_parse_chunk
+FUNCTION: Parses the lines that start in [begin, end) and stores them in the grid
+INPUT: chunk, end of the file, counters of lines, malformed lines and cells not
+at the expected centre
+RETURN: 0
+*************************************************************************************/
+int ascii_parse_chunk(char *begin, char *end, char *eof,
+		      long int *nlines, long int *nbad, long int *nbadpos)
+{
+  char *p;
+  int c, status;
+  long int m;
+  double col[12];
+
+  p = begin;
+  while( p < end )
+    {
+      status = 0;
+      for(c=0; c<12; c++)
+	{
+	  status = ascii_parse_double(&p, eof, &col[c]);
+	  if( status != 0 )
+	    break;
+	}//for c
+
+      /*+++ Next line +++*/
+      while( p < eof && *p != '\n' )
+	p++;
+      p++;
+
+      if( c == 0 && status == 1 )
+	continue; // Blank line
+
+      m = (long int) col[0];
+      if( c < 12 || m < gread->col0*GV.NCELLS || m >= (gread->col0 + gread->ncols)*GV.NCELLS )
+	{
+	  (*nbad)++;
+	  continue;
+	}//if
+
+      /*+++ Columns 4 to 8 are not used +++*/
+      grid_store(GRID_POTDOT, m, col[9]);
+      grid_store(GRID_POTDOT_L_APP1, m, col[10]);
+      grid_store(GRID_POTDOT_L_APP2, m, col[11]);
+
+      *nbadpos += grid_check_position(m, &col[1]);
+      (*nlines)++;
+    }//while
+
+  return 0;
+}//ascii_parse_chunk
+
+
+
+/*************************************************************************************
+NAME: ascii_skip_lines
+FUNCTION: Skips n lines of the text
+INPUT: position at the beginning of a line, end of the text, number of lines
+RETURN: beginning of the line n lines after p, the end of the text if there are fewer
+*************************************************************************************/
+char *ascii_skip_lines(char *p, char *eof, long int n)
+{
+  long int l;
+
+  for(l=0; l<n && p<eof; l++)
+    {
+      p = memchr(p, '\n', (size_t) (eof - p));
+      p = p == NULL ? eof : p + 1;
+    }//for l
+
+  return p;
+}//ascii_skip_lines
+
+
+
+/*************************************************************************************
+NAME: read_data_parallel
+FUNCTION: Reads the cells of the columns held by the grid from the ASCII data
+file in parallel. Every cell of the columns must be read from a well-formed line.
+INPUT: data file
+RETURN: 0, 1 if the file can not be mapped, 2 if some cells are not read or
+some lines are malformed
+*************************************************************************************/
+int read_data_parallel(char *infile)
+{
+  int fd, c, nchunks, nthreads, own;
+  struct stat st;
+  char *text, *body, *eof, **start;
+  long int nlines, nbad, nbadpos, ncells;
+
+  fd = open(infile, O_RDONLY);
+  if( fd < 0 )
+    {
+      printf("  * The file '%s' doesn't exist!\n", infile);
+      return 1;
+    }//if
+  fstat(fd, &st);
+  if( st.st_size == 0 )
+    {
+      printf("  * The file '%s' is empty!\n", infile);
+      close(fd);
+      return 1;
+    }//if
+
+  text = (char *) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if( text == MAP_FAILED )
+    return 1;
+  madvise(text, (size_t) st.st_size, MADV_SEQUENTIAL);
+  eof = text + st.st_size;
+
+  /*Ignoring the first line*/
+  body = memchr(text, '\n', (size_t) st.st_size);
+  body = body == NULL ? eof : body + 1;
+
+  /*+++ Lines of the columns held by the grid +++*/
+  ncells = gread->ncols*GV.NCELLS;
+  if( ncells < GV.NTOTALCELLS )
+    {
+      body = ascii_skip_lines(body, eof, gread->col0*GV.NCELLS);
+      eof = ascii_skip_lines(body, eof, ncells);
+    }//if
+
+  /*+++ Chunks start at the first line beginning after an even split +++*/
+  nthreads = read_threads();
+  nchunks = 1;
+#ifdef _OPENMP
+  nchunks = 8*nthreads;
+#endif
+  start = (char **) malloc((size_t) (nchunks+1)*sizeof(char *));
+  start[0] = body;
+  for(c=1; c<nchunks; c++)
+    {
+      start[c] = body + (eof - body)/nchunks*c;
+      if( start[c] < start[c-1] )
+	start[c] = start[c-1];
+      while( start[c] < eof && start[c][-1] != '\n' )
+	start[c]++;
+    }//for c
+  start[nchunks] = eof;
+
+  nlines = nbad = nbadpos = 0;
+  own = report_progress_start((long int) (eof - body), "bytes parsed");
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1) reduction(+:nlines,nbad,nbadpos)
+  for(c=0; c<nchunks; c++)
+    {
+      ascii_parse_chunk(start[c], start[c+1], eof, &nlines, &nbad, &nbadpos);
+      if( own )
+	report_progress((long int) (start[c+1] - start[c]));
+    }//for c
+
+  if( own )
+    report_progress_end();
+  report_bytes_read((long int) (eof - body));
+  free(start);
+  munmap(text, (size_t) st.st_size);
+
+  printf("%ld cells read with %d chunks\n", nlines, nchunks);
+  if( nbadpos > 0 )
+    printf("  * %ld cells are not at the centre (i+0.5)*CellSize assumed for the positions\n", nbadpos);
+  if( nlines != ncells || nbad > 0 )
+    {
+      printf("  * %ld lines could not be read, %ld of %ld cells read from '%s'!\n", nbad, nlines, ncells, infile);
+      return 2;
+    }//if
+
+  return 0;
+}//read_data_parallel
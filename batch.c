@@ -0,0 +1,282 @@
+/******************************************************************************
+NAME: batch
+FUNCTION: Batch mode over several snapshots of the same grid (same N, L,
+FORMAT and STORAGE), one parameters file each. The parameters and binary
+headers of all the snapshots are read first, and two grids of the whole
+box are allocated once, as are the workspaces of the threads and the
+maps. While snapshot n is integrated and written from gp, an I/O thread
+reads snapshot n+1 into the other grid (gread), then the two are
+swapped. The integration does not change GV, which the I/O thread reads
+the grid with (N, L, FORMAT and STORAGE, shared by all the snapshots).
+The parallel ASCII parser and decompression of the I/O thread use
+BATCH_READ_THREADS threads, on top of the threads of the sweep. Every
+snapshot is integrated with its own cosmology and a_SF and written to
+its own OUTPUT_PREFIX, BATCH_PREFIX with its number when its parameters
+file does not give one.
+INPUT: Parameters files of the snapshots
+RETURN: Output files of every snapshot
+******************************************************************************/
+
+
+/*+++ Snapshot read by the I/O thread +++*/
+struct batch_load
+{
+  char *filename; // Data file
+  int status;     // 0, 1 if it could not be read
+};
+
+
+
+/*************************************************************************************
+NAME: batch_reader
+FUNCTION: Reads one snapshot into the grid filled by the readers (gread). Runs
+in the I/O thread, GV must not change while it runs.
+INPUT: struct batch_load
+RETURN: NULL
+*************************************************************************************/
+void *batch_reader(void *arg)
+{
+  struct batch_load *load = (struct batch_load *) arg;
+
+  report_begin(PHASE_READ);
+  if( GV.INPUT_FORMAT == INPUT_BINARY )
+    load->status = read_binary(load->filename);
+  else
+    load->status = read_data(load->filename);
+  report_end(PHASE_READ);
+
+  return NULL;
+}//batch_reader
+
+
+
+/*************************************************************************************
+NAME: batch_read_parameters
+FUNCTION: Reads the parameters of every snapshot, and the header of its file for
+binary data, and checks that they share the grid of the first one
+INPUT: number of snapshots, parameters files, parameters of each snapshot
+RETURN: 0, 1 if a file can not be read or does not match the first one
+*************************************************************************************/
+int batch_read_parameters(int nsnaps, char **files, struct GlobalVariables *snaps)
+{
+  int n;
+
+  for(n=0; n<nsnaps; n++)
+    {
+      printf("Snapshot %d: %s\n", n, files[n]);
+      if( read_parameters(files[n]) != 0 )
+	return 1;
+      derived_parameters();
+      column_interp_kind_check();
+      if( los_basis() != 0 )
+	return 1;
+      if( GV.SKY_NSIDE > 0 )
+	GV.DT_DR_OUTPUT = 0;
+      if( GV.INPUT_FORMAT == INPUT_BINARY && read_binary_header() != 0 )
+	return 1;
+
+      if( GV.OUTPUT_PREFIX[0] == '\0' )
+	snprintf(GV.OUTPUT_PREFIX, sizeof(GV.OUTPUT_PREFIX), BATCH_PREFIX, n);
+      printf("z=%lf a=%lf, output to %s\n", GV.z_RS, GV.a_SF, GV.OUTPUT_PREFIX);
+
+      if( n > 0 && (GV.NCELLS != snaps[0].NCELLS || GV.BoxSize != snaps[0].BoxSize ||
+		    GV.INPUT_FORMAT != snaps[0].INPUT_FORMAT || GV.STORAGE != snaps[0].STORAGE) )
+	{
+	  printf("  * '%s' does not have the N, L, FORMAT and STORAGE of '%s'\n", files[n], files[0]);
+	  return 1;
+	}//if
+
+      if( GV.SWEEP_MODE == SWEEP_STREAM || GV.BINARY_READER == READER_MMAP )
+	printf("  * The batch reads the snapshots into two grids, SWEEP and BINARY_READER are not used\n");
+
+      snaps[n] = GV;
+    }//for n
+
+  return 0;
+}//batch_read_parameters
+
+
+
+/*************************************************************************************
+NAME: batch_integrate
+FUNCTION: Integrates and writes the maps of the snapshot in GV and gp, as a
+single run would, with the checkpoints in its OUTPUT_PREFIX. GV is not changed,
+the I/O thread reads the next snapshot with it. The maps are kept for the
+next snapshot.
+INPUT: None
+RETURN: 0, 1 if the maps can not be written
+*************************************************************************************/
+int batch_integrate(void)
+{
+  int status;
+  long int nunits;
+
+  simpson_batch_select();
+  if( GV.INTEG_MODE == INTEG_ADAPTIVE )
+    gsl_set_error_handler_off();
+
+  report_begin(PHASE_INTEGRATE);
+  if( GV.SKY_NSIDE > 0 )
+    {
+      nunits = 12*GV.SKY_NSIDE*GV.SKY_NSIDE;
+      sw_maps_alloc(nunits);
+      report_progress(checkpoint_start(nunits));
+      sweep_SW_sky();
+    }//if
+  else
+    {
+      nunits = gp.ncols;
+      sw_maps_alloc(nunits);
+      report_progress(checkpoint_start(nunits));
+      if( los_along_z() )
+	sweep_SW_maps();
+      else
+	sweep_SW_los();
+    }//else
+  checkpoint_flush();
+  report_end(PHASE_INTEGRATE);
+
+  report_begin(PHASE_OUTPUT);
+  if( GV.SKY_NSIDE > 0 )
+    status = write_sky_maps();
+  else
+    status = mpi_output_maps();
+  checkpoint_end(status);
+  report_end(PHASE_OUTPUT);
+
+  print_sw_summary(GV.SKY_NSIDE > 0 ? "Sky map" : "Interpolation");
+
+  return status;
+}//batch_integrate
+
+
+
+/*************************************************************************************
+NAME: batch_SW_maps
+FUNCTION: Runs the batch of snapshots, reading snapshot n+1 in the I/O thread
+while snapshot n is integrated. If the thread can not be started the next
+snapshot is read after the integration.
+INPUT: number of snapshots, parameters files
+RETURN: 0, 1 if a snapshot can not be read or written
+*************************************************************************************/
+int batch_SW_maps(int nsnaps, char **files)
+{
+  int n, status, threaded;
+  long int ncols, nunits;
+  struct GlobalVariables *snaps=NULL;
+  struct grid next, swap;
+  struct batch_load load;
+  pthread_t reader;
+
+  /*+++ Every snapshot needs the whole grid +++*/
+  if( GV.NPROCS > 1 )
+    {
+      printf("  * The batch is run by one of the %d processes\n", GV.NPROCS);
+      if( GV.RANK != 0 )
+	return 0;
+      GV.NPROCS = 1;
+    }//if
+
+  snaps = (struct GlobalVariables *) malloc((size_t) nsnaps*sizeof(struct GlobalVariables));
+
+  report_begin(PHASE_PARAMETERS);
+  status = batch_read_parameters(nsnaps, files, snaps);
+  report_end(PHASE_PARAMETERS);
+  if( status != 0 )
+    {
+      free(snaps);
+      return 1;
+    }//if
+  printf("--------------------------------------------------\n");
+
+  /*+++ Fields and the two grids, shared by all the snapshots +++*/
+  GV = snaps[0];
+  register_data_fields(GV.INPUT_FORMAT == INPUT_ASCII);
+
+  report_begin(PHASE_ALLOC);
+  ncols = (long int) GV.NCELLS*GV.NCELLS;
+  status = grid_alloc(ncols);
+  if( status == 0 )
+    {
+      next = gp;
+      status = grid_alloc(ncols);
+      if( status != 0 )
+	{
+	  grid_free();
+	  gp = next;
+	}//if
+    }//if
+  report_end(PHASE_ALLOC);
+  if( status != 0 )
+    {
+      grid_free();
+      free(snaps);
+      return 1;
+    }//if
+  printf("Batch of %d snapshots, two grids of %.3lf MB\n", nsnaps, gp.bytes/1048576.0);
+  printf("--------------------------------------------------\n");
+
+  /*+++ First snapshot +++*/
+  load.filename = snaps[0].FILENAME;
+  batch_reader(&load);
+  gread = &next;
+
+  /*+++ Workspaces and maps are kept from one snapshot to the next +++*/
+  column_workspace_pool_start();
+
+  nunits = 0;
+  for(n=0; n<nsnaps; n++)
+    nunits += snaps[n].SKY_NSIDE > 0 ? 12*snaps[n].SKY_NSIDE*snaps[n].SKY_NSIDE : ncols;
+  report_progress_start(nunits, "columns");
+
+  for(n=0; n<nsnaps && load.status == 0; n++)
+    {
+      GV = snaps[n];
+      printf("Snapshot %d of %d, z=%lf\n", n+1, nsnaps, GV.z_RS);
+      printf("--------------------------------------------------\n");
+
+      /*+++ Next snapshot in the I/O thread, GV stays as it is until the join +++*/
+      threaded = 0;
+      if( n+1 < nsnaps )
+	{
+	  load.filename = snaps[n+1].FILENAME;
+	  NREADTHREADS = BATCH_READ_THREADS;
+	  threaded = pthread_create(&reader, NULL, batch_reader, &load) == 0;
+	  if( !threaded )
+	    NREADTHREADS = 0;
+	}//if
+
+      status = batch_integrate();
+
+      if( threaded )
+	{
+	  pthread_join(reader, NULL);
+	  NREADTHREADS = 0;
+	}//if
+      else if( n+1 < nsnaps )
+	batch_reader(&load);
+
+      if( status != 0 )
+	break;
+
+      swap = gp;
+      gp = next;
+      next = swap;
+      printf("--------------------------------------------------\n");
+    }//for n
+
+  report_progress_end();
+  if( load.status != 0 )
+    printf("  * Snapshot %d could not be read\n", n+1);
+
+  sw_maps_free();
+  column_workspace_pool_end();
+
+  gread = &gp;
+  grid_free();
+  gp = next;
+  grid_free();
+  free(snaps);
+
+  return status != 0 || load.status != 0;
+}//batch_SW_maps
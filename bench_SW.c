@@ -0,0 +1,656 @@
+/****************************************************************************************************
+                       HEADERS
+****************************************************************************************************/
+#define _GNU_SOURCE //fopencookie, for the compressed data files
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_spline.h>
+#include <gsl/gsl_interp.h>
+#include <gsl/gsl_integration.h>
+#include <gsl/gsl_sort_float.h>
+
+
+/*************************************************************************************
+                           DEFINITION OF GLOBAL VARIABLES
+*************************************************************************************/
+double *z_depth=NULL, *PotDot=NULL, *PotDot_l_app1=NULL, *PotDot_l_app2=NULL;
+
+
+/*************************************************************************************
+                       INCLUDING SUPPORT FILES
+*************************************************************************************/
+#include "variables.c"
+#include "run_report.c"
+#include "grid_storage.c"
+#include "ascii_parser.c"
+#include "compressed_input.c"
+#include "reading.c"
+#include "mmap_reader.c"
+#include "column_interp.c"
+#include "simd_quadrature.c"
+#include "interp_PotDot_of_Z.c"
+#include "output_writer.c"
+#include "checkpoint.c"
+#include "column_sweep.c"
+#include "mpi_decomposition.c"
+
+
+/*************************************************************************************
+                           BENCHMARK DEFINITIONS
+*************************************************************************************/
+#define BENCH_BOXSIZE 400.0  //Box of the synthetic grids, the upper limit of the exact PotDot
+#define BENCH_COLUMNS 4096   //Columns sampled by the potdot_xy, simpson and SW_integral benchmarks
+#define BENCH_EVALS 1024     //Interpolations per column in the potdot_xy benchmark
+#define BENCH_SIMD_BATCHES 50 //Random batches integrated by every Simpson kernel in bench_simd_check
+#define BENCH_MAX_RESULTS 16
+#define BENCH_ASCII_FILE "./bench_grid.dat"
+#define BENCH_BINARY_FILE "./bench_grid.bin"
+
+struct bench_result
+{
+  char name[64];   // Piece of code measured
+  double seconds;  // Best time of the repeats
+  double columns;  // Columns processed
+  double samples;  // Cells read or values of the interpolant computed
+  double bytes;    // Bytes read, 0 if not meaningful
+}BR[BENCH_MAX_RESULTS]; //results
+int NBENCH = 0;        // Number of results
+double BenchSink = 0.0; // Sum of the absolute values computed, so they are not optimised away
+
+
+
+/******************************************************************************
+NAME: bench_SW
+FUNCTION: Benchmarks of the hot paths on synthetic grids. A grid of N^3
+cells of a smooth periodic field is written in both input formats in a
+scratch directory, then read_data, read_binary, fill_potdot_xy,
+potdot_xy, simpson and SW_integral are timed separately, and the whole
+run (read, sweep and write of the maps) in both formats. Each piece is
+repeated and the best time is kept. The per-column pieces work on the
+global column interpolant, so they run on one thread over at most
+BENCH_COLUMNS columns spread over the grid; reading and the whole runs
+use all the threads. The results (columns/s, ns per sample, bytes/s)
+go to a JSON file. Before timing anything, the SIMD Simpson kernels must
+give the values of the scalar ones, bit for bit, or the benchmark fails.
+Usage: bench_SW.x N [repeats] [JSON file]
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: bench_seconds
+FUNCTION: Wall-clock time
+INPUT: None
+RETURN: seconds
+*************************************************************************************/
+double bench_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}//bench_seconds
+
+
+
+/*************************************************************************************
+NAME: bench_record
+FUNCTION: Keeps the best time of a piece of code, adding it the first time
+INPUT: name, time, columns, samples and bytes processed
+RETURN: 0
+*************************************************************************************/
+int bench_record(char *name, double seconds, double columns, double samples, double bytes)
+{
+  int b;
+
+  for(b=0; b<NBENCH; b++)
+    if( strcmp(BR[b].name, name) == 0 )
+      {
+	if( seconds < BR[b].seconds )
+	  BR[b].seconds = seconds;
+	return 0;
+      }//if
+
+  if( NBENCH == BENCH_MAX_RESULTS )
+    return 0;
+
+  snprintf(BR[NBENCH].name, sizeof(BR[NBENCH].name), "%s", name);
+  BR[NBENCH].seconds = seconds;
+  BR[NBENCH].columns = columns;
+  BR[NBENCH].samples = samples;
+  BR[NBENCH].bytes = bytes;
+  NBENCH++;
+
+  printf("%-20s %12.6lf s\n", name, seconds);
+
+  return 0;
+}//bench_record
+
+
+
+/*************************************************************************************
+NAME: bench_field
+FUNCTION: Smooth periodic field of the synthetic grids, a different one for each p
+INPUT: position, field (0 exact, 1 and 2 linear approximations)
+RETURN: value
+*************************************************************************************/
+double bench_field(double x, double y, double z, int p)
+{
+  double k;
+
+  k = 2.0*M_PI/GV.BoxSize;
+
+  return sin(k*(x + p)) * cos(k*y) * sin(k*z + 0.3*p) + 0.1*p;
+}//bench_field
+
+
+
+/*************************************************************************************
+NAME: bench_generate
+FUNCTION: Writes the synthetic grid in the ASCII and binary formats of the data files
+INPUT: None
+RETURN: 0, 1 if a file can not be written
+*************************************************************************************/
+int bench_generate(void)
+{
+  int i, j, k, gid;
+  long int m;
+  double header[5], pos[3], value[3], dummy[2];
+  FILE *pa=NULL, *pb=NULL;
+
+  pa = sw_output_file(BENCH_ASCII_FILE, "w", BINARY_OUTPUT_BUFFER);
+  pb = sw_output_file(BENCH_BINARY_FILE, "w", BINARY_OUTPUT_BUFFER);
+  if( pa == NULL || pb == NULL )
+    return 1;
+
+  /*+++ Headers: BoxSize, Omega_M0, Omega_L0, z_RS, H0 +++*/
+  fprintf(pa, "#GID\t x\t y\t z\t d1\t d2\t d3\t d4\t d5\t potDot_r\t potDot_r_l_app1\t potDot_r_l_app2\n");
+  header[0] = GV.BoxSize;
+  header[1] = GV.Omega_M0;
+  header[2] = GV.Omega_L0;
+  header[3] = GV.z_RS;
+  header[4] = GV.H0;
+  fwrite(header, sizeof(double), 5, pb);
+
+  dummy[0] = dummy[1] = 0.0;
+  for(i=0; i<GV.NCELLS; i++)
+    for(j=0; j<GV.NCELLS; j++)
+      for(k=0; k<GV.NCELLS; k++)
+	{
+	  m = INDEX_C_ORDER(i,j,k);
+	  pos[X] = GRID_POS(i);
+	  pos[Y] = GRID_POS(j);
+	  pos[Z] = GRID_POS(k);
+	  value[0] = bench_field(pos[X], pos[Y], pos[Z], 0);
+	  value[1] = bench_field(pos[X], pos[Y], pos[Z], 1);
+	  value[2] = bench_field(pos[X], pos[Y], pos[Z], 2);
+
+	  fprintf(pa, "%ld %.6f %.6f %.6f 0 0 0 0 0 %.10e %.10e %.10e\n",
+		  m, pos[X], pos[Y], pos[Z], value[0], value[1], value[2]);
+
+	  /*----- GID, pos[3], DenCon, Pot, PotDot_l_app1, PotDot_l_app2 -----*/
+	  gid = (int) m;
+	  fwrite(&gid, sizeof(int), 1, pb);
+	  fwrite(pos, sizeof(double), 3, pb);
+	  fwrite(dummy, sizeof(double), 2, pb);
+	  fwrite(&value[1], sizeof(double), 2, pb);
+	}//for k
+
+  fclose(pa);
+  fclose(pb);
+
+  return 0;
+}//bench_generate
+
+
+
+/*************************************************************************************
+NAME: bench_file_size
+FUNCTION: Size of a file
+INPUT: file name
+RETURN: bytes, 0 if it does not exist
+*************************************************************************************/
+double bench_file_size(char *filename)
+{
+  struct stat st;
+
+  if( stat(filename, &st) != 0 )
+    return 0.0;
+
+  return (double) st.st_size;
+}//bench_file_size
+
+
+
+/*************************************************************************************
+NAME: bench_fields
+FUNCTION: Registers the fields of one of the input formats, clearing the registry
+INPUT: 1 for the ASCII files, with the exact PotDot
+RETURN: 0
+*************************************************************************************/
+int bench_fields(int ascii)
+{
+  int f;
+
+  NSWFIELDS = 0;
+  for(f=0; f<GRID_NFIELDS; f++)
+    gp.requested[f] = 0;
+
+  return register_data_fields(ascii);
+}//bench_fields
+
+
+
+/*************************************************************************************
+NAME: bench_read
+FUNCTION: Times the reading of the whole grid from one of the input files. The
+grid is left in memory.
+INPUT: 1 for the ASCII file, 0 for the binary file, repeats
+RETURN: 0, 1 if the memory could not be allocated or the grid read
+*************************************************************************************/
+int bench_read(int ascii, int repeats)
+{
+  int r;
+  double t0, ncolumns;
+
+  ncolumns = (double) GV.NCELLS*GV.NCELLS;
+  bench_fields(ascii);
+  snprintf(GV.FILENAME, sizeof(GV.FILENAME), "%s", ascii ? BENCH_ASCII_FILE : BENCH_BINARY_FILE);
+  GV.INPUT_FORMAT = ascii ? INPUT_ASCII : INPUT_BINARY;
+
+  for(r=0; r<repeats; r++)
+    {
+      grid_free();
+      if( grid_alloc((long int) GV.NCELLS*GV.NCELLS) != 0 )
+	return 1;
+
+      t0 = bench_seconds();
+      if( (ascii ? read_data(GV.FILENAME) : read_binary(GV.FILENAME)) != 0 )
+	return 1;
+      bench_record(ascii ? "read_data" : "read_binary", bench_seconds() - t0,
+		   ncolumns, (double) GV.NTOTALCELLS, bench_file_size(GV.FILENAME));
+    }//for r
+
+  return 0;
+}//bench_read
+
+
+
+/*************************************************************************************
+NAME: bench_simd_compare
+FUNCTION: Integrates the batches with a Simpson kernel and compares every lane
+with the integrals of the reference kernel, bit for bit
+INPUT: name, kernel, plan, batches, integrals of the reference kernel
+RETURN: number of lanes that differ
+*************************************************************************************/
+int bench_simd_compare(char *name, void (*kernel)(struct simpson_plan *, double *, double *),
+		       struct simpson_plan *plan, double *batches, double *ref)
+{
+  int b, l, ndiff;
+  double integ[SIMD_BATCH];
+
+  ndiff = 0;
+  for(b=0; b<BENCH_SIMD_BATCHES; b++)
+    {
+      kernel(plan, &batches[(size_t) b*GV.NCELLS*SIMD_BATCH], integ);
+      for(l=0; l<SIMD_BATCH; l++)
+	if( memcmp(&integ[l], &ref[b*SIMD_BATCH + l], sizeof(double)) != 0 )
+	  ndiff++;
+    }//for b
+
+  printf("Simpson kernel %-12s %d of %d lanes differ\n", name, ndiff, BENCH_SIMD_BATCHES*SIMD_BATCH);
+
+  return ndiff;
+}//bench_simd_compare
+
+
+
+/*************************************************************************************
+NAME: bench_simd_check
+FUNCTION: Checks that every batched Simpson kernel the CPU supports gives the
+same integrals as the portable ones, bit for bit, on BENCH_SIMD_BATCHES batches
+of random columns: simpson_batch_avx2 and simpson_batch_avx512 against
+simpson_batch_scalar, and their Kahan variants against simpson_batch_kahan
+INPUT: None
+RETURN: 0, 1 if a kernel differs
+*************************************************************************************/
+int bench_simd_check(void)
+{
+  int k, b, ndiff;
+  long int n;
+  double *z, *batches, *ref, *refkahan;
+  unsigned long long int seed;
+  struct simpson_plan plan;
+
+  z = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
+  batches = (double *) malloc((size_t) BENCH_SIMD_BATCHES*GV.NCELLS*SIMD_BATCH*sizeof(double));
+  ref = (double *) malloc((size_t) 2*BENCH_SIMD_BATCHES*SIMD_BATCH*sizeof(double));
+  refkahan = ref + BENCH_SIMD_BATCHES*SIMD_BATCH;
+
+  /*+++ Knots of the cell centres and random columns, as the sweep sees them +++*/
+  for(k=0; k<GV.NCELLS; k++)
+    z[k] = GV.CellStep + k*GV.CellSize;
+  seed = 2024;
+  for(n=0; n<(long int) BENCH_SIMD_BATCHES*GV.NCELLS*SIMD_BATCH; n++)
+    {
+      seed = 6364136223846793005ULL*seed + 1442695040888963407ULL;
+      batches[n] = 2e-3*((seed >> 11)*(1.0/9007199254740992.0)) - 1e-3;
+    }//for n
+
+  simpson_plan_build(&plan, z, GV.NCELLS, z[0], z[GV.NCELLS-1], INTEGRATION_NSTEPS);
+
+  for(b=0; b<BENCH_SIMD_BATCHES; b++)
+    {
+      simpson_batch_scalar(&plan, &batches[(size_t) b*GV.NCELLS*SIMD_BATCH], &ref[b*SIMD_BATCH]);
+      simpson_batch_kahan(&plan, &batches[(size_t) b*GV.NCELLS*SIMD_BATCH], &refkahan[b*SIMD_BATCH]);
+    }//for b
+
+  ndiff = 0;
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports("avx2") )
+    {
+      ndiff += bench_simd_compare("avx2", simpson_batch_avx2, &plan, batches, ref);
+      ndiff += bench_simd_compare("avx2-kahan", simpson_batch_avx2_kahan, &plan, batches, refkahan);
+    }//if
+  if( __builtin_cpu_supports("avx512f") )
+    {
+      ndiff += bench_simd_compare("avx512", simpson_batch_avx512, &plan, batches, ref);
+      ndiff += bench_simd_compare("avx512-kahan", simpson_batch_avx512_kahan, &plan, batches, refkahan);
+    }//if
+#endif
+
+  simpson_plan_free(&plan);
+  free(z);
+  free(batches);
+  free(ref);
+
+  if( ndiff > 0 )
+    {
+      printf("  * The SIMD Simpson kernels do not give the values of the scalar ones\n");
+      return 1;
+    }//if
+
+  return 0;
+}//bench_simd_check
+
+
+
+/*************************************************************************************
+NAME: bench_columns
+FUNCTION: Times the per-column pieces on the grid read from the ASCII file:
+fill_potdot_xy on every column, and potdot_xy, simpson and SW_integral on at most
+BENCH_COLUMNS columns, each timed column by column without the building of its
+interpolant
+INPUT: repeats
+RETURN: 0
+*************************************************************************************/
+int bench_columns(int repeats)
+{
+  int r, e, i, j;
+  long int c, ncolumns, step, nsampled;
+  double t0, t, tpotdot, tsimpson, tintegral, *zeval;
+  unsigned long long int seed;
+
+  ncolumns = (long int) GV.NCELLS*GV.NCELLS;
+  step = ncolumns > BENCH_COLUMNS ? ncolumns/BENCH_COLUMNS : 1;
+  nsampled = (ncolumns + step - 1)/step;
+
+  /*+++ Global column buffers of the fill_* functions +++*/
+  z_depth = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
+  PotDot  = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
+  column_interp_alloc(&PotDot_interp, GV.NCELLS);
+
+  /*+++ Points of potdot_xy, scattered over the column +++*/
+  zeval = (double *) malloc((size_t) BENCH_EVALS*sizeof(double));
+  seed = 12345;
+  for(e=0; e<BENCH_EVALS; e++)
+    {
+      seed = 6364136223846793005ULL*seed + 1442695040888963407ULL;
+      zeval[e] = 400.0*((seed >> 11)*(1.0/9007199254740992.0));
+    }//for e
+
+  for(r=0; r<repeats; r++)
+    {
+      /*+++ fill_potdot_xy: gather of the column and building of its interpolant +++*/
+      t0 = bench_seconds();
+      for(c=0; c<ncolumns; c++)
+	fill_potdot_xy(c / GV.NCELLS, c % GV.NCELLS);
+      bench_record("fill_potdot_xy", bench_seconds() - t0,
+		   (double) ncolumns, (double) GV.NTOTALCELLS, (double) GV.NTOTALCELLS*sizeof(double));
+
+      tpotdot = tsimpson = tintegral = 0.0;
+      for(c=0; c<ncolumns; c+=step)
+	{
+	  i = c / GV.NCELLS;
+	  j = c % GV.NCELLS;
+	  fill_potdot_xy(i, j);
+
+	  t = bench_seconds();
+	  for(e=0; e<BENCH_EVALS; e++)
+	    BenchSink += fabs(potdot_xy(zeval[e]));
+	  tpotdot += bench_seconds() - t;
+
+	  t = bench_seconds();
+	  BenchSink += fabs(simpson(0.0, 400.0, INTEGRATION_NSTEPS));
+	  tsimpson += bench_seconds() - t;
+
+	  t = bench_seconds();
+	  BenchSink += fabs(SW_integral());
+	  tintegral += bench_seconds() - t;
+	}//for c
+
+      bench_record("potdot_xy", tpotdot, (double) nsampled, (double) nsampled*BENCH_EVALS, 0.0);
+      bench_record("simpson", tsimpson, (double) nsampled, (double) nsampled*(INTEGRATION_NSTEPS + 1), 0.0);
+      bench_record("SW_integral", tintegral, (double) nsampled, (double) nsampled*(INTEGRATION_NSTEPS + 1), 0.0);
+    }//for r
+
+  free(zeval);
+  column_interp_free(&PotDot_interp);
+  free(z_depth);
+  free(PotDot);
+  z_depth = PotDot = NULL;
+
+  return 0;
+}//bench_columns
+
+
+
+/*************************************************************************************
+NAME: bench_run
+FUNCTION: Times a whole run: the grid is read, every column integrated with the
+column sweep and the maps written, in the same format as the input
+INPUT: 1 for the ASCII file, 0 for the binary file, repeats
+RETURN: 0, 1 if the run fails
+*************************************************************************************/
+int bench_run(int ascii, int repeats)
+{
+  int r;
+  long int ncolumns;
+  double t0;
+
+  ncolumns = (long int) GV.NCELLS*GV.NCELLS;
+  bench_fields(ascii);
+  snprintf(GV.FILENAME, sizeof(GV.FILENAME), "%s", ascii ? BENCH_ASCII_FILE : BENCH_BINARY_FILE);
+  GV.INPUT_FORMAT = ascii ? INPUT_ASCII : INPUT_BINARY;
+  GV.OUTPUT_FORMAT = ascii ? OUTPUT_ASCII : OUTPUT_BINARY;
+
+  for(r=0; r<repeats; r++)
+    {
+      grid_free();
+
+      t0 = bench_seconds();
+      if( grid_alloc(ncolumns) != 0 )
+	return 1;
+      if( (ascii ? read_data(GV.FILENAME) : read_binary(GV.FILENAME)) != 0 )
+	return 1;
+
+      sw_maps_alloc(gp.ncols);
+      sweep_SW_maps();
+      if( mpi_output_maps() != 0 )
+	return 1;
+      sw_maps_free();
+      bench_record(ascii ? "run_ascii" : "run_binary", bench_seconds() - t0,
+		   (double) ncolumns, (double) GV.NTOTALCELLS, bench_file_size(GV.FILENAME));
+    }//for r
+
+  grid_free();
+
+  return 0;
+}//bench_run
+
+
+
+/*************************************************************************************
+NAME: bench_write_json
+FUNCTION: Writes the results, one object per piece of code with its best time,
+columns/s, ns per sample and bytes/s (null when no bytes are read)
+INPUT: file, repeats, threads
+RETURN: 0
+*************************************************************************************/
+int bench_write_json(FILE *pf, int repeats, int threads)
+{
+  int b;
+
+  fprintf(pf, "{\n");
+  fprintf(pf, "  \"ncells\": %d,\n", GV.NCELLS);
+  fprintf(pf, "  \"threads\": %d,\n", threads);
+  fprintf(pf, "  \"repeats\": %d,\n", repeats);
+  fprintf(pf, "  \"integration_nsteps\": %d,\n", INTEGRATION_NSTEPS);
+  fprintf(pf, "  \"simd_batch\": %d,\n", SIMD_BATCH);
+  fprintf(pf, "  \"checksum\": %.17g,\n", BenchSink);
+  fprintf(pf, "  \"results\": {\n");
+  for(b=0; b<NBENCH; b++)
+    {
+      fprintf(pf, "    \"%s\": {\"seconds\": %.9g, \"columns_per_s\": %.9g, \"ns_per_sample\": %.9g, \"bytes_per_s\": ",
+	      BR[b].name, BR[b].seconds, BR[b].columns/BR[b].seconds, 1e9*BR[b].seconds/BR[b].samples);
+      if( BR[b].bytes > 0.0 )
+	fprintf(pf, "%.9g}", BR[b].bytes/BR[b].seconds);
+      else
+	fprintf(pf, "null}");
+      fprintf(pf, "%s\n", b < NBENCH-1 ? "," : "");
+    }//for b
+  fprintf(pf, "  }\n");
+  fprintf(pf, "}\n");
+
+  return 0;
+}//bench_write_json
+
+
+
+/*******************************************************************
+NAME: main
+FUNCTION: Generates the synthetic grids and runs all the benchmarks
+INPUT: N, repeats (3 by default), JSON file (bench_N<N>.json by default)
+RETURN: 0
+******************************************************************/
+int main(int argc, char *argv[])
+{
+  int repeats, threads;
+  char jsonfile[1000], scratch[1000];
+  FILE *pf=NULL;
+
+  if( argc < 2 )
+    {
+      printf("Error: Incomplete number of parameters. Execute as follows:\n");
+      printf("%s N [repeats] [JSON file]\n", argv[0]);
+      exit(0);
+    }//if
+
+  /*+++ Synthetic grid and default run options +++*/
+  GV.NCELLS = atoi(argv[1]);
+  repeats = argc > 2 ? atoi(argv[2]) : 3;
+  if( GV.NCELLS < 4 || repeats < 1 )
+    {
+      printf("  * N must be at least 4 and repeats at least 1\n");
+      exit(0);
+    }//if
+
+  default_run_options();
+  GV.RANK = 0;
+  GV.NPROCS = 1;
+  GV.BoxSize      = BENCH_BOXSIZE;
+  GV.Omega_M0     = 0.258;
+  GV.Omega_L0     = 0.742;
+  GV.z_RS         = 0.0;
+  GV.H0           = 100.0;
+  GV.a_SF         = 1.0/(1.0 + GV.z_RS);
+  GV.ZERO         = 1e-30;
+  GV.NTOTALCELLS  = (long int) GV.NCELLS*GV.NCELLS*GV.NCELLS;
+  GV.CellSize     = GV.BoxSize/(1.0*GV.NCELLS);
+  GV.CellStep     = GV.CellSize / 2.0;
+
+  threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+
+  /*+++ Results in the current directory, grids and maps in a scratch one +++*/
+  if( argc > 3 )
+    snprintf(jsonfile, sizeof(jsonfile), "%s", argv[3]);
+  else
+    snprintf(jsonfile, sizeof(jsonfile), "./bench_N%d.json", GV.NCELLS);
+  pf = sw_output_file(jsonfile, "w", 0);
+  if( pf == NULL )
+    exit(0);
+
+  snprintf(scratch, sizeof(scratch), "./bench_N%d", GV.NCELLS);
+  mkdir(scratch, 0755);
+  if( chdir(scratch) != 0 )
+    {
+      printf("  * The directory '%s' can not be used\n", scratch);
+      exit(0);
+    }//if
+
+  printf("NCells=%d Threads=%d Repeats=%d\n", GV.NCELLS, threads, repeats);
+  column_interp_kind_check();
+  simpson_batch_select();
+  if( bench_simd_check() != 0 )
+    exit(1);
+  printf("--------------------------------------------------\n");
+
+  printf("Writing the synthetic grids in %s\n", scratch);
+  if( bench_generate() != 0 )
+    exit(0);
+  printf("--------------------------------------------------\n");
+
+  /*+++ Readers, then the per-column pieces on the ASCII grid +++*/
+  if( bench_read(0, repeats) != 0 || bench_read(1, repeats) != 0 )
+    exit(0);
+  bench_columns(repeats);
+  grid_free();
+
+  /*+++ Whole runs +++*/
+  if( bench_run(1, repeats) != 0 || bench_run(0, repeats) != 0 )
+    exit(0);
+
+  bench_write_json(pf, repeats, threads);
+  fclose(pf);
+
+  printf("--------------------------------------------------\n");
+  printf("Results written to %s\n", jsonfile);
+  printf("--------------------------------------------------\n");
+
+  return 0;
+}//main
@@ -0,0 +1,481 @@
+/******************************************************************************
+NAME: checkpoint
+FUNCTION: Checkpoints and restart of the sweeps of the maps. The sweeps mark
+every column (ray, pixel) once its maps are complete, and every CHECKPOINT
+seconds one of the threads writes the ranges of the columns done with
+their values to CHECKPOINT_FILE (one file per process with several MPI
+processes), first to a temporary file that then replaces the last
+checkpoint. With RESTART = 1 the maps of the last checkpoint are read back
+and the sweeps skip the columns it holds; when it holds all of them the
+data file is not read at all. With BINARY_READER = mmap the restarted run
+maps the data file again, from the page cache when it is still there, and
+only the pages of the columns left are touched. The file is removed once
+the maps are written. It is, in order:
+  char magic[8]      "SWCKPT02"
+  int  NCELLS, nfields, errors (1 if the errors of the maps follow them)
+  long int col0, nunits (first column and columns of the maps)
+  double a_SF, LOS[3]
+  int  INTEG_MODE, INTERP_KIND, STORAGE
+  double BoxSize
+  long int size and mtime of FILENAME (-1 and 0 when it can not be read)
+  long int SKY_NSIDE
+  double OBSERVER[3], RMAX
+  char names[nfields][SW_NAME_LEN]
+  double CheckMaxDiff, StorageMaxDiff, MaxError and long int NFailed of every field
+  long int nranges, ranges[nranges][2] (first and last + 1 column of each range)
+  double values of every field in the ranges, then their errors
+The ranges are the same for every field, all the fields of a column are
+integrated together. dT/dr is not kept, DT_DR runs are not checkpointed,
+and SWEEP = stream writes every slab as it goes.
+INPUT: GV.CHECKPOINT, GV.RESTART
+RETURN: CHECKPOINT_FILE
+******************************************************************************/
+
+
+
+/*************************************************************************************
+NAME: checkpoint_path
+FUNCTION: Path of the checkpoint of this process
+INPUT: path and its size
+RETURN: path
+*************************************************************************************/
+char *checkpoint_path(char *path, size_t size)
+{
+  char filename[1100];
+
+  if( GV.NPROCS > 1 )
+    snprintf(filename, sizeof(filename), "%s_%d.bin", CHECKPOINT_FILE, GV.RANK);
+  else
+    snprintf(filename, sizeof(filename), "%s.bin", CHECKPOINT_FILE);
+
+  return sw_output_path(filename, path, size);
+}//checkpoint_path
+
+
+
+/*************************************************************************************
+NAME: checkpoint_data_stamp
+FUNCTION: Size and modification time of the data file, to tell a checkpoint of
+other data with the same name
+INPUT: size and mtime
+RETURN: none
+*************************************************************************************/
+void checkpoint_data_stamp(long int *size, long int *mtime)
+{
+  struct stat st;
+
+  *size = -1;
+  *mtime = 0;
+
+  if( stat(GV.FILENAME, &st) == 0 )
+    {
+      *size = (long int) st.st_size;
+      *mtime = (long int) st.st_mtime;
+    }//if
+}//checkpoint_data_stamp
+
+
+
+/*************************************************************************************
+NAME: checkpoint_done
+FUNCTION: Tells if the maps of a column are complete
+INPUT: place of the column in the maps
+RETURN: 1 if the column is done, 0 otherwise or without checkpoints
+*************************************************************************************/
+int checkpoint_done(long int u)
+{
+  unsigned char done;
+
+  if( CKPT.done == NULL )
+    return 0;
+
+#pragma omp atomic read seq_cst
+  done = CKPT.done[u];
+
+  return done;
+}//checkpoint_done
+
+
+
+/*************************************************************************************
+NAME: checkpoint_all_done
+FUNCTION: Tells if the maps of consecutive columns are all complete
+INPUT: place of the first column in the maps, number of columns
+RETURN: 1 if they are all done, 0 otherwise
+*************************************************************************************/
+int checkpoint_all_done(long int u, long int n)
+{
+  long int k;
+
+  if( CKPT.done == NULL )
+    return 0;
+
+  for(k=u; k<u+n; k++)
+    if( !checkpoint_done(k) )
+      return 0;
+
+  return 1;
+}//checkpoint_all_done
+
+
+
+/*************************************************************************************
+NAME: checkpoint_write
+FUNCTION: Writes the ranges of the columns done and their maps, replacing the
+last checkpoint only once the new one is on disk. The columns being
+integrated while it is written go to the next checkpoint.
+INPUT: None
+RETURN: 0, 1 if the checkpoint can not be written
+*************************************************************************************/
+int checkpoint_write(void)
+{
+  int f, status, errors;
+  long int u, r, nranges, *ranges, size, mtime, nfailed[MAX_SW_FIELDS];
+  double t0, stats[MAX_SW_FIELDS][3];
+  char path[2100], tmp[2200];
+  FILE *pf=NULL;
+
+  t0 = report_time();
+  errors = SWF[0].SW_err != NULL;
+  checkpoint_data_stamp(&size, &mtime);
+
+  /*+++ Statistics of the fields, the other threads may be updating them +++*/
+  for(f=0; f<NSWFIELDS; f++)
+    {
+#pragma omp critical (integ_check)
+      {
+	stats[f][0] = SWF[f].CheckMaxDiff;
+	stats[f][2] = SWF[f].MaxError;
+	nfailed[f] = SWF[f].NFailed;
+      }
+#pragma omp critical (storage_check)
+      stats[f][1] = SWF[f].StorageMaxDiff;
+    }//for f
+
+  /*+++ Ranges of the columns done so far, their maps are complete +++*/
+  ranges = (long int *) malloc((size_t) (CKPT.nunits + 2)*sizeof(long int));
+  nranges = 0;
+  u = 0;
+  while( u < CKPT.nunits )
+    {
+      if( !checkpoint_done(u) )
+	{
+	  u++;
+	  continue;
+	}//if
+
+      ranges[2*nranges] = u;
+      while( u < CKPT.nunits && checkpoint_done(u) )
+	u++;
+      ranges[2*nranges+1] = u;
+      nranges++;
+    }//while
+
+  checkpoint_path(path, sizeof(path));
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  pf = fopen(tmp, "wb");
+  if( pf == NULL )
+    {
+      printf("  * The checkpoint '%s' can not be written!\n", tmp);
+      free(ranges);
+      return 1;
+    }//if
+  setvbuf(pf, NULL, _IOFBF, BINARY_OUTPUT_BUFFER);
+
+  /*+++ Header +++*/
+  fwrite("SWCKPT02", 1, 8, pf);
+  fwrite(&GV.NCELLS, sizeof(int), 1, pf);
+  fwrite(&NSWFIELDS, sizeof(int), 1, pf);
+  fwrite(&errors, sizeof(int), 1, pf);
+  fwrite(&gp.col0, sizeof(long int), 1, pf);
+  fwrite(&CKPT.nunits, sizeof(long int), 1, pf);
+  fwrite(&GV.a_SF, sizeof(double), 1, pf);
+  fwrite(GV.LOS, sizeof(double), 3, pf);
+  fwrite(&GV.INTEG_MODE, sizeof(int), 1, pf);
+  fwrite(&GV.INTERP_KIND, sizeof(int), 1, pf);
+  fwrite(&GV.STORAGE, sizeof(int), 1, pf);
+  fwrite(&GV.BoxSize, sizeof(double), 1, pf);
+  fwrite(&size, sizeof(long int), 1, pf);
+  fwrite(&mtime, sizeof(long int), 1, pf);
+  fwrite(&GV.SKY_NSIDE, sizeof(long int), 1, pf);
+  fwrite(GV.OBSERVER, sizeof(double), 3, pf);
+  fwrite(&GV.RMAX, sizeof(double), 1, pf);
+  for(f=0; f<NSWFIELDS; f++)
+    fwrite(SWF[f].name, 1, SW_NAME_LEN, pf);
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      fwrite(stats[f], sizeof(double), 3, pf);
+      fwrite(&nfailed[f], sizeof(long int), 1, pf);
+    }//for f
+  fwrite(&nranges, sizeof(long int), 1, pf);
+  fwrite(ranges, sizeof(long int), (size_t) 2*nranges, pf);
+
+  /*+++ Maps of the ranges +++*/
+  for(f=0; f<NSWFIELDS; f++)
+    for(r=0; r<nranges; r++)
+      fwrite(&SWF[f].SW_map[ranges[2*r]], sizeof(double), (size_t) (ranges[2*r+1] - ranges[2*r]), pf);
+  if( errors )
+    for(f=0; f<NSWFIELDS; f++)
+      for(r=0; r<nranges; r++)
+	fwrite(&SWF[f].SW_err[ranges[2*r]], sizeof(double), (size_t) (ranges[2*r+1] - ranges[2*r]), pf);
+
+  status = fflush(pf) != 0 || ferror(pf) || fsync(fileno(pf)) != 0;
+  status = fclose(pf) != 0 || status;
+  free(ranges);
+
+  if( status != 0 || rename(tmp, path) != 0 )
+    {
+      printf("  * The checkpoint '%s' can not be written!\n", tmp);
+      remove(tmp);
+      return 1;
+    }//if
+
+  printf("  Checkpoint '%s' written, %ld ranges of columns, %.3lf s\n", path, nranges, report_time() - t0);
+  fflush(stdout);
+
+  return 0;
+}//checkpoint_write
+
+
+
+/*************************************************************************************
+NAME: checkpoint_read
+FUNCTION: Reads the maps of the checkpoint of an earlier run and marks its
+columns as done. A checkpoint of other data, fields, columns or settings of
+the integration is ignored.
+The NFailed counts kept may include columns that were being integrated when
+it was written, which are integrated again.
+INPUT: path of the checkpoint
+RETURN: number of columns done, 0 if there is no checkpoint or it is ignored
+*************************************************************************************/
+long int checkpoint_read(char *path)
+{
+  int f, ncells, nfields, errors, mode[3], ok;
+  long int u, r, col0, nunits, nranges, ndone, *ranges=NULL, nfailed[MAX_SW_FIELDS];
+  long int size, mtime, stamp[2], nside;
+  double a_SF, los[3], box, observer[3], rmax, stats[MAX_SW_FIELDS][3];
+  char magic[8], name[SW_NAME_LEN];
+  FILE *pf=NULL;
+
+  pf = fopen(path, "rb");
+  if( pf == NULL )
+    {
+      printf("  * There is no checkpoint '%s', starting from the first column\n", path);
+      return 0;
+    }//if
+
+  checkpoint_data_stamp(&size, &mtime);
+
+  /*+++ Header: same data, fields, columns and integration +++*/
+  ok = fread(magic, 1, 8, pf) == 8 && memcmp(magic, "SWCKPT02", 8) == 0;
+  ok = ok && fread(&ncells, sizeof(int), 1, pf) == 1 && ncells == GV.NCELLS;
+  ok = ok && fread(&nfields, sizeof(int), 1, pf) == 1 && nfields == NSWFIELDS;
+  ok = ok && fread(&errors, sizeof(int), 1, pf) == 1 && errors == (SWF[0].SW_err != NULL);
+  ok = ok && fread(&col0, sizeof(long int), 1, pf) == 1 && col0 == gp.col0;
+  ok = ok && fread(&nunits, sizeof(long int), 1, pf) == 1 && nunits == CKPT.nunits;
+  ok = ok && fread(&a_SF, sizeof(double), 1, pf) == 1 && a_SF == GV.a_SF;
+  ok = ok && fread(los, sizeof(double), 3, pf) == 3 &&
+    los[X] == GV.LOS[X] && los[Y] == GV.LOS[Y] && los[Z] == GV.LOS[Z];
+  ok = ok && fread(mode, sizeof(int), 3, pf) == 3 &&
+    mode[0] == GV.INTEG_MODE && mode[1] == GV.INTERP_KIND && mode[2] == GV.STORAGE;
+  ok = ok && fread(&box, sizeof(double), 1, pf) == 1 && box == GV.BoxSize;
+  ok = ok && fread(stamp, sizeof(long int), 2, pf) == 2 && stamp[0] == size && stamp[1] == mtime;
+  ok = ok && fread(&nside, sizeof(long int), 1, pf) == 1 && nside == GV.SKY_NSIDE;
+  ok = ok && fread(observer, sizeof(double), 3, pf) == 3 &&
+    observer[X] == GV.OBSERVER[X] && observer[Y] == GV.OBSERVER[Y] && observer[Z] == GV.OBSERVER[Z];
+  ok = ok && fread(&rmax, sizeof(double), 1, pf) == 1 && rmax == GV.RMAX;
+  for(f=0; f<NSWFIELDS && ok; f++)
+    ok = fread(name, 1, SW_NAME_LEN, pf) == SW_NAME_LEN && strncmp(name, SWF[f].name, SW_NAME_LEN) == 0;
+  if( !ok )
+    {
+      printf("  * The checkpoint '%s' is not of this run, starting from the first column\n", path);
+      fclose(pf);
+      return 0;
+    }//if
+
+  for(f=0; f<NSWFIELDS && ok; f++)
+    ok = fread(stats[f], sizeof(double), 3, pf) == 3 && fread(&nfailed[f], sizeof(long int), 1, pf) == 1;
+  ok = ok && fread(&nranges, sizeof(long int), 1, pf) == 1 && nranges >= 0 && nranges <= CKPT.nunits;
+  if( ok )
+    {
+      ranges = (long int *) malloc((size_t) (2*nranges + 1)*sizeof(long int));
+      ok = fread(ranges, sizeof(long int), (size_t) 2*nranges, pf) == (size_t) 2*nranges;
+    }//if
+  for(r=0; r<nranges && ok; r++)
+    ok = ranges[2*r] >= 0 && ranges[2*r] < ranges[2*r+1] && ranges[2*r+1] <= CKPT.nunits;
+
+  /*+++ Maps of the ranges, the columns are marked only once all of them are read +++*/
+  for(f=0; f<NSWFIELDS && ok; f++)
+    for(r=0; r<nranges && ok; r++)
+      ok = fread(&SWF[f].SW_map[ranges[2*r]], sizeof(double), (size_t) (ranges[2*r+1] - ranges[2*r]), pf) ==
+	(size_t) (ranges[2*r+1] - ranges[2*r]);
+  for(f=0; f<NSWFIELDS && ok && errors; f++)
+    for(r=0; r<nranges && ok; r++)
+      ok = fread(&SWF[f].SW_err[ranges[2*r]], sizeof(double), (size_t) (ranges[2*r+1] - ranges[2*r]), pf) ==
+	(size_t) (ranges[2*r+1] - ranges[2*r]);
+  fclose(pf);
+
+  if( !ok )
+    {
+      printf("  * The checkpoint '%s' is incomplete, starting from the first column\n", path);
+      free(ranges);
+      return 0;
+    }//if
+
+  ndone = 0;
+  for(r=0; r<nranges; r++)
+    for(u=ranges[2*r]; u<ranges[2*r+1]; u++)
+      {
+	ndone += !CKPT.done[u];
+	CKPT.done[u] = 1;
+      }//for u
+
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      SWF[f].CheckMaxDiff = stats[f][0];
+      SWF[f].StorageMaxDiff = stats[f][1];
+      SWF[f].MaxError = stats[f][2];
+      SWF[f].NFailed = nfailed[f];
+    }//for f
+
+  free(ranges);
+
+  return ndone;
+}//checkpoint_read
+
+
+
+/*************************************************************************************
+NAME: checkpoint_start
+FUNCTION: Starts the checkpoints of the maps just allocated, and reads the last
+checkpoint back with RESTART = 1
+INPUT: columns (rays, pixels) of the maps
+RETURN: number of columns already done
+*************************************************************************************/
+long int checkpoint_start(long int nunits)
+{
+  long int ndone;
+  char path[2100];
+
+  CKPT.done = NULL;
+  CKPT.nunits = nunits;
+  CKPT.last = report_time();
+  CKPT.writing = 0;
+
+  if( GV.CHECKPOINT <= 0.0 && !GV.RESTART )
+    return 0;
+
+  if( GV.DT_DR_OUTPUT )
+    {
+      printf("  * The checkpoints do not keep dT/dr, DT_DR runs are not checkpointed\n");
+      return 0;
+    }//if
+
+  CKPT.done = (unsigned char *) calloc((size_t) nunits, sizeof(unsigned char));
+  if( CKPT.done == NULL )
+    {
+      printf("  * No memory for the checkpoints, the run is not checkpointed\n");
+      return 0;
+    }//if
+
+  checkpoint_path(path, sizeof(path));
+  ndone = 0;
+  if( GV.RESTART )
+    {
+      ndone = checkpoint_read(path);
+      if( ndone > 0 )
+	printf("Restarting from '%s': %ld of %ld columns done\n", path, ndone, nunits);
+    }//if
+
+  if( GV.CHECKPOINT > 0.0 )
+    printf("Checkpoint every %g s to '%s'\n", GV.CHECKPOINT, path);
+
+  return ndone;
+}//checkpoint_start
+
+
+
+/*************************************************************************************
+NAME: checkpoint_mark
+FUNCTION: Marks consecutive columns as done once their maps are complete, and
+writes a checkpoint when CHECKPOINT seconds have gone by since the last one.
+Only one thread writes it, the others go on with their columns.
+INPUT: place of the first column in the maps, number of columns
+RETURN: none
+*************************************************************************************/
+void checkpoint_mark(long int u, long int n)
+{
+  long int k;
+  int busy;
+  double last;
+
+  if( CKPT.done == NULL )
+    return;
+
+  for(k=u; k<u+n; k++)
+    {
+#pragma omp atomic write seq_cst
+      CKPT.done[k] = 1;
+    }//for k
+
+  if( GV.CHECKPOINT <= 0.0 )
+    return;
+
+#pragma omp atomic read
+  last = CKPT.last;
+  if( report_time() - last < GV.CHECKPOINT )
+    return;
+
+#pragma omp atomic capture
+  { busy = CKPT.writing; CKPT.writing = 1; }
+  if( busy )
+    return;
+
+  checkpoint_write();
+
+  last = report_time();
+#pragma omp atomic write
+  CKPT.last = last;
+#pragma omp atomic write
+  CKPT.writing = 0;
+}//checkpoint_mark
+
+
+
+/*************************************************************************************
+NAME: checkpoint_flush
+FUNCTION: Writes a last checkpoint once the sweep is over, so a run stopped while
+the maps are written does not integrate them again
+INPUT: None
+RETURN: 0, 1 if the checkpoint can not be written
+*************************************************************************************/
+int checkpoint_flush(void)
+{
+  if( CKPT.done == NULL || GV.CHECKPOINT <= 0.0 )
+    return 0;
+
+  return checkpoint_write();
+}//checkpoint_flush
+
+
+
+/*************************************************************************************
+NAME: checkpoint_end
+FUNCTION: Ends the checkpoints of the maps, removing the checkpoint once the maps
+are written
+INPUT: 0 if the maps were written
+RETURN: none
+*************************************************************************************/
+void checkpoint_end(int status)
+{
+  char path[2100];
+
+  if( CKPT.done == NULL )
+    return;
+
+  if( status == 0 )
+    remove(checkpoint_path(path, sizeof(path)));
+
+  free(CKPT.done);
+  CKPT.done = NULL;
+}//checkpoint_end
@@ -0,0 +1,569 @@
+/******************************************************************************
+NAME: column_interp
+FUNCTION: Reusable interpolant PotDot(z) for one (i,j) column. The GSL
+accelerator and spline are allocated once per run, re-initialised once
+per column after the column buffers are filled, and then sampled by
+every Simpson step without any heap traffic. The adaptive quadrature
+uses a GSL workspace kept in the interpolant as well. The kind of
+interpolation is INTERP in the parameters file. The linear one is
+evaluated by GSL; the cubic ones (cspline, akima, steffen) are Hermite
+cubics on each segment, so once per column the derivatives at the knots
+are taken from GSL and turned into a flat table of polynomial
+coefficients, and every sample is one Horner evaluation of the table.
+INPUT: Column buffers z_depth[] and PotDot[] of GV.NCELLS values.
+RETURN: Interpolated values and integrals of PotDot(z) along the column.
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: column_interp_type
+FUNCTION: GSL interpolation type of a kind of interpolation
+INPUT: kind (INTERP_*)
+RETURN: GSL type
+*************************************************************************************/
+const gsl_interp_type *column_interp_type(int kind)
+{
+  if( kind == INTERP_CSPLINE )
+    return gsl_interp_cspline;
+  if( kind == INTERP_AKIMA )
+    return gsl_interp_akima;
+  if( kind == INTERP_STEFFEN )
+    return gsl_interp_steffen;
+
+  return gsl_interp_linear;
+}//column_interp_type
+
+
+
+/*************************************************************************************
+NAME: column_interp_kind_check
+FUNCTION: Falls back to linear interpolation when the columns have fewer knots
+than the kind chosen in the parameters file needs, and reports the kind used
+INPUT: None
+RETURN: 0
+*************************************************************************************/
+int column_interp_kind_check(void)
+{
+  const gsl_interp_type *type;
+  char *names[4] = {"linear", "cspline", "akima", "steffen"};
+
+  type = column_interp_type(GV.INTERP_KIND);
+  if( (unsigned int) GV.NCELLS < gsl_interp_type_min_size(type) )
+    {
+      printf("  * %s interpolation needs %u cells per column, using linear\n",
+	     names[GV.INTERP_KIND], gsl_interp_type_min_size(type));
+      GV.INTERP_KIND = INTERP_LINEAR;
+    }//if
+
+  printf("Interpolation=%s\n", names[GV.INTERP_KIND]);
+
+  return 0;
+}//column_interp_kind_check
+
+
+
+/*************************************************************************************
+NAME: column_interp_alloc
+FUNCTION: Allocates the accelerator, the spline and, for the cubic kinds, the
+coefficient table of a column interpolant
+INPUT: interpolant, number of knots per column
+RETURN: 0
+*************************************************************************************/
+int column_interp_alloc(struct column_interp *ci, int nknots)
+{
+  ci->nknots = nknots;
+  ci->z      = NULL;
+  ci->f      = NULL;
+  ci->kind   = GV.INTERP_KIND;
+  ci->cache  = 0;
+  ci->coef   = NULL;
+  ci->acc    = gsl_interp_accel_alloc();
+  ci->spline = gsl_spline_alloc(column_interp_type(ci->kind), (size_t) nknots);
+  if( ci->kind != INTERP_LINEAR )
+    ci->coef = (double *) malloc((size_t) 4*(nknots-1)*sizeof(double));
+  ci->qag    = NULL;
+  ci->pts    = NULL;
+  ci->error  = 0.0;
+  ci->status = 0;
+  ci->nevals = 0;
+  ci->compensated = GV.STORAGE == STORAGE_FLOAT;
+
+  return 0;
+}//column_interp_alloc
+
+
+
+/*************************************************************************************
+NAME: column_interp_build
+FUNCTION: Builds the interpolant for the column currently stored in z[], f[]. For
+the cubic kinds segment k is the Hermite cubic with the values f[k], f[k+1]
+and the GSL derivatives d[k], d[k+1] at its ends:
+  p(u) = f[k] + d[k] u + (3 s - 2 d[k] - d[k+1])/h u^2 + (d[k] + d[k+1] - 2 s)/h^2 u^3
+with u = z - z[k], h = z[k+1] - z[k] and s = (f[k+1] - f[k])/h.
+INPUT: interpolant, knot positions and values (nknots each)
+RETURN: 0
+*************************************************************************************/
+int column_interp_build(struct column_interp *ci, double *z, double *f)
+{
+  int k;
+  double h, slope, d0, d1, *c;
+
+  ci->z = z;
+  ci->f = f;
+
+  gsl_spline_init(ci->spline, z, f, (size_t) ci->nknots);
+  gsl_interp_accel_reset(ci->acc);
+
+  if( ci->kind == INTERP_LINEAR )
+    return 0;
+
+  ci->cache = 0;
+  d1 = gsl_spline_eval_deriv(ci->spline, z[0], ci->acc);
+  for(k=0; k<ci->nknots-1; k++)
+    {
+      d0 = d1;
+      d1 = gsl_spline_eval_deriv(ci->spline, z[k+1], ci->acc);
+
+      h = z[k+1] - z[k];
+      slope = (f[k+1] - f[k])/h;
+
+      c = &ci->coef[4*k];
+      c[0] = f[k];
+      c[1] = d0;
+      c[2] = (3.0*slope - 2.0*d0 - d1)/h;
+      c[3] = (d0 + d1 - 2.0*slope)/(h*h);
+    }//for k
+
+  return 0;
+}//column_interp_build
+
+
+
+/*************************************************************************************
+NAME: column_interp_segment
+FUNCTION: Segment of the coefficient table containing zeval, z[k] <= zeval < z[k+1]
+(the first or last one outside the knots). The last segment found is tried
+first, then the next one, so increasing samples cost O(1).
+INPUT: interpolant, point of evaluation
+RETURN: segment
+*************************************************************************************/
+int column_interp_segment(struct column_interp *ci, double zeval)
+{
+  int k, lo, hi, mid;
+  double *z;
+
+  z = ci->z;
+  k = ci->cache;
+
+  if( zeval >= z[k] && (zeval < z[k+1] || k == ci->nknots-2) )
+    return k;
+  if( k+1 < ci->nknots-1 && zeval >= z[k+1] && (zeval < z[k+2] || k+1 == ci->nknots-2) )
+    {
+      ci->cache = k+1;
+      return k+1;
+    }//if
+
+  lo = 0;
+  hi = ci->nknots-1;
+  while( hi - lo > 1 )
+    {
+      mid = (lo + hi)/2;
+      if( z[mid] > zeval )
+	hi = mid;
+      else
+	lo = mid;
+    }//while
+
+  ci->cache = lo;
+
+  return lo;
+}//column_interp_segment
+
+
+
+/*************************************************************************************
+NAME: column_interp_eval
+FUNCTION: Evaluates the interpolant of the current column at zeval, with GSL
+for the linear kind and from the coefficient table for the cubic ones
+INPUT: interpolant, point of evaluation
+RETURN: PotDot(zeval)
+*************************************************************************************/
+double column_interp_eval(struct column_interp *ci, double zeval)
+{
+  int k;
+  double u, *c;
+
+  if( ci->kind == INTERP_LINEAR )
+    return gsl_spline_eval(ci->spline, zeval, ci->acc);
+
+  k = column_interp_segment(ci, zeval);
+  c = &ci->coef[4*k];
+  u = zeval - ci->z[k];
+
+  return c[0] + u*(c[1] + u*(c[2] + u*c[3]));
+}//column_interp_eval
+
+
+
+/*************************************************************************************
+NAME: column_interp_free
+FUNCTION: Frees the accelerator, the spline, the coefficient table and the
+adaptive workspace of a column interpolant, adding its count of values to
+the run report
+INPUT: interpolant
+RETURN: none
+*************************************************************************************/
+void column_interp_free(struct column_interp *ci)
+{
+#pragma omp atomic
+  RUN.evals += ci->nevals;
+  ci->nevals = 0;
+
+  gsl_spline_free(ci->spline);
+  gsl_interp_accel_free(ci->acc);
+  free(ci->coef);
+  if( ci->qag != NULL )
+    gsl_integration_workspace_free(ci->qag);
+  free(ci->pts);
+
+  ci->spline = NULL;
+  ci->acc    = NULL;
+  ci->coef   = NULL;
+  ci->qag    = NULL;
+  ci->pts    = NULL;
+}//column_interp_free
+
+
+
+/*************************************************************************************
+NAME: kahan_add
+FUNCTION: Adds x to a Kahan sum, keeping the low-order bits lost by the addition
+in the compensation
+INPUT: sum, compensation, value
+RETURN: none
+*************************************************************************************/
+static inline void kahan_add(double *sum, double *comp, double x)
+{
+  double y, t;
+
+  y = x - *comp;
+  t = *sum + y;
+  *comp = (t - *sum) - y;
+  *sum = t;
+}//kahan_add
+
+
+
+/*************************************************************************************
+NAME: simpson_column
+FUNCTION: Simpson integral of the current column interpolant between a and b.
+The even and odd samples are visited in increasing z, so the accelerator
+finds each knot interval in O(1). With ci->compensated they are added up
+with Kahan sums.
+INPUT: interpolant, limits of integration, number of intervals (even)
+RETURN: integral
+*************************************************************************************/
+double simpson_column(struct column_interp *ci, double a, double b, int Nsamples)
+{
+  double min,max;
+  double x0, f0, hstep, feven, fodd, xn, fn, integ, xie, xio, ceven, codd;
+  int i;
+
+  max = b;
+  min = a;
+
+  hstep = (max-min)/(Nsamples*1.0);
+
+  x0 = min;
+  f0 = column_interp_eval(ci, x0);
+
+  feven = 0.0;
+  ceven = 0.0;
+  xie = x0 + 2.0*hstep;
+
+  for(i=2; i<=(Nsamples-2); i=i+2)
+    {
+      if( ci->compensated )
+	kahan_add(&feven, &ceven, column_interp_eval(ci, xie));
+      else
+	feven = feven + column_interp_eval(ci, xie);
+      xie = xie + 2.0*hstep;
+    }//for i
+
+
+  fodd = 0.0;
+  codd = 0.0;
+  xio = x0 + hstep;
+
+  for(i=1; i<=Nsamples-1; i=i+2)
+    {
+      if( ci->compensated )
+	kahan_add(&fodd, &codd, column_interp_eval(ci, xio));
+      else
+	fodd = fodd + column_interp_eval(ci, xio);
+      xio = xio + 2.0*hstep;
+    }//for i
+
+  xn = max;
+  fn = column_interp_eval(ci, xn);
+
+  integ = (hstep/3.0)*(f0 + 2.0*feven + 4.0*fodd + fn);
+  ci->nevals += Nsamples + 1;
+
+  return integ;
+}//simpson_column
+
+
+
+/*************************************************************************************
+NAME: column_interp_integrate
+FUNCTION: Closed-form integral of the interpolant of the current column
+between a and b, computed knot by knot with the trapezoid of each segment
+(linear kind) or the antiderivative of its cubic (cubic kinds).
+The segments need not be uniform, so the widened end segments forced by
+the fill_* functions (z_depth[0]=0, z_depth[N-1]=400 or BoxSize) are exact
+too. Limits outside the knots are clipped to [z[0], z[N-1]], and segments
+that do not increase in z are skipped. The first segment is found by
+bisection, so short intervals cost O(log N). With ci->compensated the
+segments are added up with a Kahan sum.
+INPUT: interpolant, limits of integration
+RETURN: integral
+*************************************************************************************/
+double column_interp_integrate(struct column_interp *ci, double a, double b)
+{
+  int k, n, lo, hi, mid;
+  double *z, *f, *c;
+  double za, zb, fa, fb, slope, integ, ua, ub, part, comp;
+
+  if( b < a )
+    return -column_interp_integrate(ci, b, a);
+
+  n = ci->nknots;
+  z = ci->z;
+  f = ci->f;
+
+  if( a < z[0] )
+    a = z[0];
+  if( b > z[n-1] )
+    b = z[n-1];
+
+  integ = 0.0;
+  comp = 0.0;
+
+  /*+++ First segment ending after a, by bisection +++*/
+  lo = 0;
+  hi = n-1;
+  while( hi - lo > 1 )
+    {
+      mid = (lo + hi)/2;
+      if( z[mid] > a )
+	hi = mid;
+      else
+	lo = mid;
+    }//while
+
+  for(k=lo; k<n-1; k++)
+    {
+      if( z[k+1] <= z[k] || z[k+1] <= a )
+	continue;
+      if( z[k] >= b )
+	break;
+
+      if( ci->kind != INTERP_LINEAR )
+	{
+	  c  = &ci->coef[4*k];
+	  ua = (a > z[k] ? a : z[k]) - z[k];
+	  ub = (b < z[k+1] ? b : z[k+1]) - z[k];
+	  part = ub*(c[0] + ub*(c[1]/2.0 + ub*(c[2]/3.0 + ub*c[3]/4.0)))
+	    - ua*(c[0] + ua*(c[1]/2.0 + ua*(c[2]/3.0 + ua*c[3]/4.0)));
+	}//if
+      else
+	{
+	  slope = (f[k+1] - f[k])/(z[k+1] - z[k]);
+
+	  za = z[k];
+	  fa = f[k];
+	  if( za < a )
+	    {
+	      za = a;
+	      fa = f[k] + (a - z[k])*slope;
+	    }//if
+
+	  zb = z[k+1];
+	  fb = f[k+1];
+	  if( zb > b )
+	    {
+	      zb = b;
+	      fb = f[k] + (b - z[k])*slope;
+	    }//if
+
+	  part = 0.5*(zb - za)*(fa + fb);
+	}//else
+
+      if( ci->compensated )
+	kahan_add(&integ, &comp, part);
+      else
+	integ = integ + part;
+    }//for k
+
+  return integ;
+}//column_interp_integrate
+
+
+
+/*************************************************************************************
+NAME: column_interp_integrand
+FUNCTION: Integrand of the adaptive quadrature, the interpolant passed in params
+INPUT: point of evaluation, interpolant
+RETURN: PotDot(z)
+*************************************************************************************/
+double column_interp_integrand(double z, void *params)
+{
+  struct column_interp *ci = (struct column_interp *) params;
+
+  ci->nevals++;
+
+  return column_interp_eval(ci, z);
+}//column_interp_integrand
+
+
+
+/*************************************************************************************
+NAME: column_interp_adaptive
+FUNCTION: Adaptive Gauss-Kronrod integral (gsl_integration_qagp) of the current
+column between a and b, with the knots inside (a,b) as breakpoints so that no
+subinterval straddles a kink of the interpolant. The tolerances are EPSABS and
+EPSREL of the parameters file. The estimated error and the GSL status are left
+in ci->error and ci->status.
+INPUT: interpolant, limits of integration
+RETURN: integral
+*************************************************************************************/
+double column_interp_adaptive(struct column_interp *ci, double a, double b)
+{
+  int k, npts;
+  double result, sign;
+  gsl_function F;
+
+  if( ci->qag == NULL )
+    {
+      ci->qag = gsl_integration_workspace_alloc((size_t) ci->nknots + ADAPTIVE_LIMIT);
+      ci->pts = (double *) malloc((size_t) (ci->nknots+2)*sizeof(double));
+    }//if
+
+  ci->error  = 0.0;
+  ci->status = 0;
+
+  sign = 1.0;
+  if( b < a )
+    {
+      result = a;
+      a = b;
+      b = result;
+      sign = -1.0;
+    }//if
+  if( b == a )
+    return 0.0;
+
+  /*+++ Limits and the knots between them +++*/
+  npts = 0;
+  ci->pts[npts++] = a;
+  for(k=0; k<ci->nknots; k++)
+    if( ci->z[k] > a && ci->z[k] < b )
+      ci->pts[npts++] = ci->z[k];
+  ci->pts[npts++] = b;
+
+  F.function = &column_interp_integrand;
+  F.params = ci;
+
+  ci->status = gsl_integration_qagp(&F, ci->pts, (size_t) npts, GV.EPSABS, GV.EPSREL,
+				    (size_t) ci->nknots + ADAPTIVE_LIMIT, ci->qag, &result, &ci->error);
+
+  return sign*result;
+}//column_interp_adaptive
+
+
+
+/*************************************************************************************
+NAME: integrate_column_n
+FUNCTION: Integrates the current column between a and b with the method
+chosen by INTEGRATION in the parameters file (GV.INTEG_MODE), using
+Nsamples Simpson intervals. In INTEG_CHECK mode *checkdiff keeps the
+largest |exact - simpson| found. In INTEG_ADAPTIVE mode the estimated error
+is left in ci->error.
+INPUT: interpolant, limits of integration, Simpson intervals (even), largest
+difference so far
+RETURN: integral
+*************************************************************************************/
+double integrate_column_n(struct column_interp *ci, double a, double b, int Nsamples, double *checkdiff)
+{
+  double exact, simp;
+
+  if( GV.INTEG_MODE == INTEG_SIMPSON )
+    return simpson_column(ci, a, b, Nsamples);
+
+  if( GV.INTEG_MODE == INTEG_ADAPTIVE )
+    return column_interp_adaptive(ci, a, b);
+
+  exact = column_interp_integrate(ci, a, b);
+
+  if( GV.INTEG_MODE == INTEG_CHECK )
+    {
+      simp = simpson_column(ci, a, b, Nsamples);
+#pragma omp critical (integ_check)
+      {
+	if( fabs(exact - simp) > *checkdiff )
+	  *checkdiff = fabs(exact - simp);
+      }
+    }//if
+
+  return exact;
+}//integrate_column_n
+
+
+
+/*************************************************************************************
+NAME: integrate_column
+FUNCTION: Integrates the current column between a and b with INTEGRATION_NSTEPS
+Simpson intervals or the method chosen in the parameters file
+INPUT: interpolant, limits of integration, largest difference so far
+RETURN: integral
+*************************************************************************************/
+double integrate_column(struct column_interp *ci, double a, double b, double *checkdiff)
+{
+  return integrate_column_n(ci, a, b, INTEGRATION_NSTEPS, checkdiff);
+}//integrate_column
+
+
+
+/*************************************************************************************
+NAME: storage_check_column
+FUNCTION: STORAGE_CHECK mode: rounds the values of the current column to float,
+integrates it again with Kahan sums as STORAGE = float would, and keeps in
+*maxdiff the largest difference from the integral of the doubles (both times
+a_SF). The values are left rounded and the interpolant rebuilt on them.
+INPUT: interpolant, limits of integration, Simpson intervals (even), integral of
+the doubles, largest difference so far
+RETURN: 0
+*************************************************************************************/
+int storage_check_column(struct column_interp *ci, double a, double b, int Nsamples,
+			 double integ, double *maxdiff)
+{
+  int k;
+  double single, checkdiff=0.0;
+
+  for(k=0; k<ci->nknots; k++)
+    ci->f[k] = (float) ci->f[k];
+  column_interp_build(ci, ci->z, ci->f);
+
+  ci->compensated = 1;
+  single = integrate_column_n(ci, a, b, Nsamples, &checkdiff);
+  ci->compensated = 0;
+
+#pragma omp critical (storage_check)
+  {
+    if( fabs(GV.a_SF*(single - integ)) > *maxdiff )
+      *maxdiff = fabs(GV.a_SF*(single - integ));
+  }
+
+  return 0;
+}//storage_check_column
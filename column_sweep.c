@@ -0,0 +1,564 @@
+/******************************************************************************
+NAME: column_sweep
+FUNCTION: Integrates every (i,j) column of the grid along z in parallel.
+The fields to integrate are listed once with register_sw_field(); the
+sweep then gathers each column a single time for all of them. Each
+thread owns a column_workspace, so the columns do not share the global
+z_depth/PotDot buffers used by the fill_* functions, and the columns are
+handed out with a dynamic schedule. The results are stored in maps
+indexed by (i,j), so the output is written in the same order whatever
+the number of threads. With Simpson integration the columns are taken in
+batches of SIMD_BATCH and integrated in lockstep (see simd_quadrature.c).
+INPUT: The grid gp already read (whole, or a slab of columns when streaming).
+RETURN: One map per registered field with the integrals of the columns in gp.
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: register_sw_field
+FUNCTION: Adds a grid field to the column sweep and requests it from the grid
+storage, so it must be called before grid_alloc
+INPUT: name, grid field (GRID_*), last knot and upper limit
+of the integral, output file, header line and row format of the output
+RETURN: index of the field in SWF[], -1 if the registry is full
+*************************************************************************************/
+int register_sw_field(char *name, int field, double zmax,
+		      char *outfile, char *header, char *rowformat)
+{
+  struct sw_field *swf;
+
+  if( NSWFIELDS == MAX_SW_FIELDS )
+    {
+      printf("  * Too many SW fields, '%s' not registered\n", name);
+      return -1;
+    }//if
+
+  swf = &SWF[NSWFIELDS];
+  snprintf(swf->name, sizeof(swf->name), "%s", name);
+  swf->field = field;
+  swf->zmax = zmax;
+  snprintf(swf->outfile, sizeof(swf->outfile), "%s", outfile);
+  snprintf(swf->header, sizeof(swf->header), "%s", header);
+  snprintf(swf->rowformat, sizeof(swf->rowformat), "%s", rowformat);
+  snprintf(swf->errformat, sizeof(swf->errformat), "%.*s %%16.8e\n",
+	   (int) strcspn(rowformat, "\n"), rowformat);
+  swf->CheckMaxDiff = 0.0;
+  swf->SW_map = NULL;
+  swf->dT_dr = NULL;
+  swf->SW_err = NULL;
+  swf->plan.nsamples = 0;
+  swf->plan.k = NULL;
+  swf->plan.t = NULL;
+
+  grid_request_field(field);
+
+  NSWFIELDS++;
+
+  return NSWFIELDS-1;
+}//register_sw_field
+
+
+
+/*************************************************************************************
+NAME: register_data_fields
+FUNCTION: Registers the fields of the data files integrated along z
+INPUT: 1 to register the exact PotDot, only present in the ASCII files
+RETURN: 0
+*************************************************************************************/
+int register_data_fields(int exact)
+{
+  /*Exact PotDot (not present in the binary files)*/
+  if( exact )
+    register_sw_field("PotDot", GRID_POTDOT, 400.0,
+		      "./SW_Integral_Exact_sln.dat", "#n\t i\t j\t x\t y\t SW_Integral",
+		      "%12d %12d %12d %16.8f %16.8f %16.8f\n");
+
+  /*Linear regime with the first approximation to f(t) proportional to 1/Omega_L0*/
+  register_sw_field("PotDot_l_app1", GRID_POTDOT_L_APP1, GV.BoxSize,
+		    "./SWIntegral_LApp1.dat", "#n\t i\t j\t x\t y\t z\t SW_Integral_l",
+		    "%d %d %d %f %f %f\n");
+
+  /*Linear regime with the second approximation to f(t) proportional to Omega_M(a)*/
+  register_sw_field("PotDot_l_app2", GRID_POTDOT_L_APP2, GV.BoxSize,
+		    "./SWIntegral_LApp2.dat", "#n\t i\t j\t x\t y\t z\t SW_Integral_l_app2",
+		    "%d %d %d %f %f %f\n");
+
+  return 0;
+}//register_data_fields
+
+
+
+/*************************************************************************************
+NAME: column_workspace_alloc
+FUNCTION: Allocates the column buffers of all registered fields and the
+interpolant of a workspace. The knots in z are the same for every column:
+the cell centres, with the first knot moved to 0 as in the fill_* functions
+(the last knot depends on the field, see build_column).
+INPUT: workspace, number of cells per column
+RETURN: 0
+*************************************************************************************/
+int column_workspace_alloc(struct column_workspace *ws, int nknots)
+{
+  int k;
+
+  ws->z_depth = (double *) malloc((size_t) nknots*sizeof(double));
+  ws->PotDot  = (double *) malloc((size_t) NSWFIELDS*nknots*sizeof(double));
+  ws->T_depth = (double *) malloc((size_t) nknots*sizeof(double));
+  ws->batch   = (double *) calloc((size_t) NSWFIELDS*nknots*SIMD_BATCH, sizeof(double));
+  column_interp_alloc(&ws->ci, nknots);
+
+  for(k=0; k<nknots; k++)
+    ws->z_depth[k] = GRID_POS(k);
+  ws->z_depth[0] = 0.0;
+
+  return 0;
+}//column_workspace_alloc
+
+
+
+/*************************************************************************************
+NAME: column_workspace_free
+FUNCTION: Frees a workspace
+INPUT: workspace
+RETURN: none
+*************************************************************************************/
+void column_workspace_free(struct column_workspace *ws)
+{
+  column_interp_free(&ws->ci);
+  free(ws->z_depth);
+  free(ws->PotDot);
+  free(ws->T_depth);
+  free(ws->batch);
+}//column_workspace_free
+
+
+
+/*************************************************************************************
+NAME: column_workspace_pool_start, column_workspace_pool_end
+FUNCTION: Keeps the workspaces of the threads from one sweep to the next, for the
+snapshots of a batch or the slabs of a stream, then frees them
+INPUT: None
+RETURN: none
+*************************************************************************************/
+void column_workspace_pool_start(void)
+{
+  WSPOOL.active = 1;
+}//column_workspace_pool_start
+
+
+void column_workspace_pool_end(void)
+{
+  int t;
+
+  for(t=0; t<POOL_MAX_THREADS; t++)
+    if( WSPOOL.ready[t] )
+      {
+	column_workspace_free(&WSPOOL.ws[t]);
+	WSPOOL.ready[t] = 0;
+      }//if
+
+  WSPOOL.active = 0;
+}//column_workspace_pool_end
+
+
+
+/*************************************************************************************
+NAME: column_workspace_take
+FUNCTION: Workspace of the calling thread for a sweep: the one kept in the pool,
+allocated on first use and again when INTERP or STORAGE changed, or its own
+one when the pool is not active
+INPUT: workspace of the thread outside the pool
+RETURN: workspace to use
+*************************************************************************************/
+struct column_workspace *column_workspace_take(struct column_workspace *own)
+{
+  int t=0;
+
+#ifdef _OPENMP
+  t = omp_get_thread_num();
+#endif
+
+  if( !WSPOOL.active || t >= POOL_MAX_THREADS )
+    {
+      column_workspace_alloc(own, GV.NCELLS);
+      return own;
+    }//if
+
+  if( WSPOOL.ready[t] && (WSPOOL.ws[t].ci.kind != GV.INTERP_KIND ||
+			  WSPOOL.ws[t].ci.compensated != (GV.STORAGE == STORAGE_FLOAT)) )
+    {
+      column_workspace_free(&WSPOOL.ws[t]);
+      WSPOOL.ready[t] = 0;
+    }//if
+
+  if( !WSPOOL.ready[t] )
+    {
+      column_workspace_alloc(&WSPOOL.ws[t], GV.NCELLS);
+      WSPOOL.ready[t] = 1;
+    }//if
+
+  return &WSPOOL.ws[t];
+}//column_workspace_take
+
+
+
+/*************************************************************************************
+NAME: column_workspace_give
+FUNCTION: Ends the use of a workspace by a sweep: its own one is freed, one of the
+pool is kept, with its count of values added to the run report
+INPUT: workspace used, workspace of the thread outside the pool
+RETURN: none
+*************************************************************************************/
+void column_workspace_give(struct column_workspace *ws, struct column_workspace *own)
+{
+  if( ws == own )
+    {
+      column_workspace_free(own);
+      return;
+    }//if
+
+#pragma omp atomic
+  RUN.evals += ws->ci.nevals;
+  ws->ci.nevals = 0;
+}//column_workspace_give
+
+
+
+/*************************************************************************************
+NAME: gather_column
+FUNCTION: Copies the column (i,j) of every registered field into a workspace.
+Each column is contiguous in the grid, so these are unit-stride copies (or
+one run of records when the binary file is memory-mapped).
+INPUT: workspace, column (i,j)
+RETURN: 0
+*************************************************************************************/
+int gather_column(struct column_workspace *ws, int i, int j)
+{
+  int f;
+  long int m;
+
+  m = INDEX_C_ORDER(i,j,0);
+
+  for(f=0; f<NSWFIELDS; f++)
+    grid_gather(SWF[f].field, m, GV.NCELLS, &ws->PotDot[f*GV.NCELLS]);
+
+  return 0;
+}//gather_column
+
+
+
+/*************************************************************************************
+NAME: build_column
+FUNCTION: Builds the interpolant of one gathered field, with the last knot at
+the field's zmax (400 for the exact solution, BoxSize for the approximations)
+INPUT: workspace, index of the field in SWF[]
+RETURN: 0
+*************************************************************************************/
+int build_column(struct column_workspace *ws, int f)
+{
+  ws->z_depth[GV.NCELLS-1] = SWF[f].zmax;
+
+  column_interp_build(&ws->ci, ws->z_depth, &ws->PotDot[f*GV.NCELLS]);
+
+  return 0;
+}//build_column
+
+
+
+/*************************************************************************************
+NAME: sw_maps_alloc
+FUNCTION: Allocates the maps of all the registered fields for ncols columns, and
+their dT/dr when GV.DT_DR_OUTPUT is set and their errors in INTEG_ADAPTIVE mode,
+resets their check differences and builds their Simpson plans on the knots of
+build_column. Maps still allocated by an earlier call are reused (resized in
+place), so a batch keeps them from one snapshot to the next.
+INPUT: number of columns held by the grid
+RETURN: 0
+*************************************************************************************/
+int sw_maps_alloc(long int ncols)
+{
+  int f, k;
+  double *z;
+
+  z = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
+  for(k=0; k<GV.NCELLS; k++)
+    z[k] = GRID_POS(k);
+  z[0] = 0.0;
+
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      z[GV.NCELLS-1] = SWF[f].zmax;
+      simpson_plan_free(&SWF[f].plan);
+      if( simpson_plan_build(&SWF[f].plan, z, GV.NCELLS, 0.0, SWF[f].zmax, INTEGRATION_NSTEPS) != 0 )
+	printf("  * The Simpson samples of %s are outside its knots, integrating column by column\n", SWF[f].name);
+
+      SWF[f].SW_map = (double *) realloc(SWF[f].SW_map, (size_t) ncols*sizeof(double));
+
+      if( GV.DT_DR_OUTPUT )
+	SWF[f].dT_dr = (double *) realloc(SWF[f].dT_dr, (size_t) ncols*GV.NCELLS*sizeof(double));
+      else
+	{
+	  free(SWF[f].dT_dr);
+	  SWF[f].dT_dr = NULL;
+	}//else
+
+      if( GV.INTEG_MODE == INTEG_ADAPTIVE )
+	SWF[f].SW_err = (double *) realloc(SWF[f].SW_err, (size_t) ncols*sizeof(double));
+      else
+	{
+	  free(SWF[f].SW_err);
+	  SWF[f].SW_err = NULL;
+	}//else
+      SWF[f].CheckMaxDiff = 0.0;
+      SWF[f].StorageMaxDiff = 0.0;
+      SWF[f].MaxError = 0.0;
+      SWF[f].NFailed = 0;
+    }//for f
+
+  free(z);
+
+  return 0;
+}//sw_maps_alloc
+
+
+
+/*************************************************************************************
+NAME: sw_maps_free
+FUNCTION: Frees the maps and the Simpson plans of all the registered fields
+INPUT: none
+RETURN: none
+*************************************************************************************/
+void sw_maps_free(void)
+{
+  int f;
+
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      free(SWF[f].SW_map);
+      free(SWF[f].dT_dr);
+      free(SWF[f].SW_err);
+      SWF[f].SW_map = NULL;
+      SWF[f].dT_dr = NULL;
+      SWF[f].SW_err = NULL;
+      simpson_plan_free(&SWF[f].plan);
+    }//for f
+}//sw_maps_free
+
+
+
+/*************************************************************************************
+NAME: print_sw_summary
+FUNCTION: Prints the check and storage differences and the estimated errors of
+the maps of every registered field
+INPUT: what was integrated ("Interpolation", "Sky map")
+RETURN: none
+*************************************************************************************/
+void print_sw_summary(char *what)
+{
+  int f;
+
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      printf("%s of %s finished!\n", what, SWF[f].name);
+      if( GV.INTEG_MODE == INTEG_CHECK )
+	printf("Largest |exact - simpson| difference: %e\n", SWF[f].CheckMaxDiff);
+      if( GV.STORAGE == STORAGE_CHECK )
+	printf("Largest |double - float| difference: %e\n", SWF[f].StorageMaxDiff);
+      if( GV.INTEG_MODE == INTEG_ADAPTIVE )
+	printf("Largest estimated error: %e, %ld columns above the tolerance\n", SWF[f].MaxError, SWF[f].NFailed);
+    }//for f
+}//print_sw_summary
+
+
+
+/*************************************************************************************
+NAME: integrate_sw_field
+FUNCTION: Integrates one gathered field of the column in a workspace and stores
+a_SF times the integral at place c of the maps, with its estimated error in
+INTEG_ADAPTIVE mode and its dT/dr profile if requested. In STORAGE_CHECK mode
+the column is then integrated again from its values rounded to float.
+INPUT: workspace, index of the field in SWF[], place in the maps
+RETURN: 0
+*************************************************************************************/
+int integrate_sw_field(struct column_workspace *ws, int f, long int c)
+{
+  double integ;
+
+  build_column(ws, f);
+  integ = integrate_column(&ws->ci, 0.0, SWF[f].zmax, &SWF[f].CheckMaxDiff);
+  SWF[f].SW_map[c] = GV.a_SF*integ;
+
+  if( SWF[f].SW_err != NULL )
+    {
+      SWF[f].SW_err[c] = GV.a_SF*ws->ci.error;
+#pragma omp critical (integ_check)
+      {
+	if( SWF[f].SW_err[c] > SWF[f].MaxError )
+	  SWF[f].MaxError = SWF[f].SW_err[c];
+	if( ws->ci.status != 0 )
+	  SWF[f].NFailed++;
+      }
+    }//if
+
+  if( SWF[f].dT_dr != NULL )
+    dT_dr_column(&ws->ci, SWF[f].zmax, ws->T_depth,
+		 &SWF[f].dT_dr[c*GV.NCELLS], &SWF[f].CheckMaxDiff);
+
+  if( GV.STORAGE == STORAGE_CHECK )
+    storage_check_column(&ws->ci, 0.0, SWF[f].zmax, INTEGRATION_NSTEPS, integ, &SWF[f].StorageMaxDiff);
+
+  return 0;
+}//integrate_sw_field
+
+
+
+/*************************************************************************************
+NAME: sweep_SW_columns
+FUNCTION: Column by column sweep, integrating each column with its own interpolant.
+In INTEG_ADAPTIVE mode the estimated error of each column goes to SW_err. The
+columns of the checkpoint of an earlier run are skipped.
+INPUT: none
+RETURN: 0
+*************************************************************************************/
+int sweep_SW_columns(void)
+{
+  long int c;
+  int f;
+
+#pragma omp parallel private(f)
+  {
+    struct column_workspace own, *ws;
+    int i, j;
+    double t0;
+
+    ws = column_workspace_take(&own);
+    t0 = report_time();
+
+#pragma omp for schedule(dynamic, SWEEP_CHUNK) nowait
+    for(c=gp.col0; c<gp.col0+gp.ncols; c++)
+      {
+	if( checkpoint_done(c - gp.col0) )
+	  continue;
+
+	i = c / GV.NCELLS;
+	j = c % GV.NCELLS;
+
+	gather_column(ws, i, j);
+
+	for(f=0; f<NSWFIELDS; f++)
+	  integrate_sw_field(ws, f, c - gp.col0);
+
+	checkpoint_mark(c - gp.col0, 1);
+	report_columns(1);
+      }//for c
+
+    report_busy(t0);
+    column_workspace_give(ws, &own);
+  }//omp parallel
+
+  return 0;
+}//sweep_SW_columns
+
+
+
+/*************************************************************************************
+NAME: sweep_SW_batches
+FUNCTION: Batched sweep for Simpson integration. The columns of a batch are
+gathered one by one and interleaved, then every field is integrated for the
+whole batch with one call to the batched kernel. The dT/dr profiles still
+use the interpolant of each column. A batch is skipped when all its columns
+are in the checkpoint of an earlier run.
+INPUT: none
+RETURN: 0
+*************************************************************************************/
+int sweep_SW_batches(void)
+{
+  long int b, nbatches;
+
+  nbatches = (gp.ncols + SIMD_BATCH - 1)/SIMD_BATCH;
+
+#pragma omp parallel
+  {
+    struct column_workspace own, *ws;
+    int i, j, k, f, l, nb;
+    long int c0;
+    double t0, integ[SIMD_BATCH];
+
+    ws = column_workspace_take(&own);
+    t0 = report_time();
+
+#pragma omp for schedule(dynamic, SWEEP_CHUNK/SIMD_BATCH) nowait
+    for(b=0; b<nbatches; b++)
+      {
+	c0 = gp.col0 + b*SIMD_BATCH;
+	nb = gp.col0 + gp.ncols - c0 < SIMD_BATCH ? (int) (gp.col0 + gp.ncols - c0) : SIMD_BATCH;
+	if( checkpoint_all_done(c0 - gp.col0, nb) )
+	  continue;
+
+	for(l=0; l<nb; l++)
+	  {
+	    i = (c0 + l) / GV.NCELLS;
+	    j = (c0 + l) % GV.NCELLS;
+
+	    gather_column(ws, i, j);
+
+	    for(f=0; f<NSWFIELDS; f++)
+	      {
+		for(k=0; k<GV.NCELLS; k++)
+		  ws->batch[(f*GV.NCELLS + k)*SIMD_BATCH + l] = ws->PotDot[f*GV.NCELLS + k];
+
+		if( SWF[f].dT_dr != NULL )
+		  {
+		    build_column(ws, f);
+		    dT_dr_column(&ws->ci, SWF[f].zmax, ws->T_depth,
+				 &SWF[f].dT_dr[(c0 + l - gp.col0)*GV.NCELLS], &SWF[f].CheckMaxDiff);
+		  }//if
+	      }//for f
+	  }//for l
+
+	for(f=0; f<NSWFIELDS; f++)
+	  {
+	    simpson_batch(&SWF[f].plan, &ws->batch[f*GV.NCELLS*SIMD_BATCH], integ);
+	    for(l=0; l<nb; l++)
+	      SWF[f].SW_map[c0 + l - gp.col0] = GV.a_SF*integ[l];
+	    ws->ci.nevals += (long int) nb*SWF[f].plan.nsamples;
+	  }//for f
+
+	checkpoint_mark(c0 - gp.col0, nb);
+	report_columns(nb);
+      }//for b
+
+    report_busy(t0);
+    column_workspace_give(ws, &own);
+  }//omp parallel
+
+  return 0;
+}//sweep_SW_batches
+
+
+
+/*************************************************************************************
+NAME: sweep_SW_maps
+FUNCTION: Computes a_SF times the SW integral between 0 and zmax of the columns
+held by the grid, for all the registered fields. Column c goes to
+SW_map[c - gp.col0], and its dT/dr profile, if requested, to
+dT_dr[(c - gp.col0)*NCELLS + k]. Simpson integration of the linear interpolant
+goes through the batched kernel when the plans of all the fields could be built,
+except in STORAGE_CHECK mode, which integrates every column twice.
+INPUT: none
+RETURN: 0
+*************************************************************************************/
+int sweep_SW_maps(void)
+{
+  int f;
+
+  if( GV.INTEG_MODE != INTEG_SIMPSON || GV.INTERP_KIND != INTERP_LINEAR || simpson_batch == NULL ||
+      GV.STORAGE == STORAGE_CHECK )
+    return sweep_SW_columns();
+
+  for(f=0; f<NSWFIELDS; f++)
+    if( SWF[f].plan.nsamples == 0 )
+      return sweep_SW_columns();
+
+  return sweep_SW_batches();
+}//sweep_SW_maps
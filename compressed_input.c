@@ -0,0 +1,487 @@
+/******************************************************************************
+NAME: compressed_input
+FUNCTION: Data files compressed with gzip, or with zstd when built with
+HAVE_ZSTD, are read directly, without an uncompressed copy on disk. The
+compression is detected from the first bytes of the file. input_open
+returns a stdio stream of the decompressed bytes (fopencookie), so the
+ASCII parser and the binary record decoder read it as they read a plain
+file. Independent frames whose sizes are in the file (BGZF blocks of
+gzip, zstd frames with their content size) are decompressed in parallel,
+INPUT_FRAMES at a time; any other stream is decompressed in order. The
+streams can only seek forward, skipping decompressed bytes.
+INPUT: Data file
+RETURN: stdio stream of the decompressed data
+******************************************************************************/
+
+
+/*+++ State of one compressed data file +++*/
+struct input_stream
+{
+  FILE *raw;             // Compressed file
+  int kind;              // COMPRESS_GZIP or COMPRESS_ZSTD
+  unsigned char *in;     // Compressed bytes read, the next ones at in[inpos..inlen)
+  size_t inpos, inlen;
+  int eof;               // 1 once the whole compressed file is in 'in'
+  char *out;             // Decompressed bytes, the next ones at out[outpos..outlen)
+  size_t outpos, outlen, outsize;
+  long int pos;          // Decompressed bytes handed to the reader
+  int midframe;          // 1 while a frame is being decompressed in order
+  z_stream zs;           // gzip decoder of the frames decompressed in order
+#ifdef HAVE_ZSTD
+  ZSTD_DCtx *zd;         // zstd decoder of the frames decompressed in order
+#endif
+};
+
+
+
+/*************************************************************************************
+NAME: input_compression
+FUNCTION: Compression of a file, from its magic bytes
+INPUT: file name
+RETURN: COMPRESS_NONE (also if it can not be read), COMPRESS_GZIP or COMPRESS_ZSTD
+*************************************************************************************/
+int input_compression(char *filename)
+{
+  size_t nread;
+  unsigned char magic[4];
+  FILE *pf=NULL;
+
+  pf = fopen(filename, "r");
+  if( pf == NULL )
+    return COMPRESS_NONE;
+  nread = fread(magic, 1, sizeof(magic), pf);
+  fclose(pf);
+
+  if( nread >= 2 && magic[0] == 0x1f && magic[1] == 0x8b )
+    return COMPRESS_GZIP;
+  if( nread == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd )
+    return COMPRESS_ZSTD;
+
+  return COMPRESS_NONE;
+}//input_compression
+
+
+
+/*************************************************************************************
+NAME: input_refill
+FUNCTION: Moves the compressed bytes not used yet to the start of the buffer and
+reads more after them
+INPUT: stream
+RETURN: none
+*************************************************************************************/
+void input_refill(struct input_stream *s)
+{
+  size_t nread;
+
+  if( s->eof )
+    return;
+
+  memmove(s->in, s->in + s->inpos, s->inlen - s->inpos);
+  s->inlen = s->inlen - s->inpos;
+  s->inpos = 0;
+
+  nread = fread(s->in + s->inlen, 1, INPUT_BUFFER - s->inlen, s->raw);
+  s->inlen += nread;
+  if( s->inlen < INPUT_BUFFER )
+    s->eof = 1;
+}//input_refill
+
+
+
+/*************************************************************************************
+NAME: input_frame_size
+FUNCTION: Compressed and decompressed sizes of the frame at in[p], if they are
+written in the file and the whole frame is in the buffer: a BGZF block (gzip
+member with its size in the 'BC' extra field and ISIZE in its trailer) or a
+zstd frame with its content size
+INPUT: stream, position in the buffer, sizes
+RETURN: 1 if the frame can be decompressed on its own, 0 otherwise
+*************************************************************************************/
+int input_frame_size(struct input_stream *s, size_t p, size_t *csize, size_t *usize)
+{
+  size_t avail, xlen, x;
+  unsigned char *b;
+
+  b = s->in + p;
+  avail = s->inlen - p;
+
+  if( s->kind == COMPRESS_GZIP )
+    {
+      if( avail < 18 || b[0] != 0x1f || b[1] != 0x8b || b[2] != 8 || !(b[3] & 4) )
+	return 0;
+
+      xlen = b[10] | (size_t) b[11] << 8;
+      *csize = 0;
+      for(x=12; x+4<=12+xlen && x+4<=avail; x+=4 + (b[x+2] | (size_t) b[x+3] << 8))
+	if( b[x] == 'B' && b[x+1] == 'C' && b[x+2] == 2 && b[x+3] == 0 && x+6 <= avail )
+	  *csize = (b[x+4] | (size_t) b[x+5] << 8) + 1;
+
+      if( *csize == 0 || *csize > avail )
+	return 0;
+
+      b = b + *csize - 4;
+      *usize = b[0] | (size_t) b[1] << 8 | (size_t) b[2] << 16 | (size_t) b[3] << 24;
+      return 1;
+    }//if
+
+#ifdef HAVE_ZSTD
+  if( s->kind == COMPRESS_ZSTD )
+    {
+      unsigned long long content;
+
+      *csize = ZSTD_findFrameCompressedSize(b, avail);
+      if( ZSTD_isError(*csize) )
+	return 0;
+
+      content = ZSTD_getFrameContentSize(b, avail);
+      if( content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR ||
+	  content > INPUT_FRAME_MAX )
+	return 0;
+
+      *usize = (size_t) content;
+      return 1;
+    }//if
+#endif
+
+  return 0;
+}//input_frame_size
+
+
+
+/*************************************************************************************
+NAME: input_out_size
+FUNCTION: Grows the buffer of decompressed bytes to hold at least n
+INPUT: stream, bytes
+RETURN: 0, 1 if the memory can not be allocated
+*************************************************************************************/
+int input_out_size(struct input_stream *s, size_t n)
+{
+  char *out;
+
+  if( n <= s->outsize )
+    return 0;
+
+  out = (char *) realloc(s->out, n);
+  if( out == NULL )
+    {
+      printf("  * Not enough memory to decompress the data file\n");
+      return 1;
+    }//if
+
+  s->out = out;
+  s->outsize = n;
+
+  return 0;
+}//input_out_size
+
+
+
+/*************************************************************************************
+NAME: input_fill_frames
+FUNCTION: Decompresses the next independent frames of the buffer, up to
+INPUT_FRAMES, in parallel, each one into its place of the decompressed bytes
+INPUT: stream
+RETURN: 1 if frames were decompressed, 0 if the next frame is not independent,
+-1 on a decompression error
+*************************************************************************************/
+int input_fill_frames(struct input_stream *s)
+{
+  int n, nframes, nbad;
+  size_t p, csize, usize, total;
+  size_t coff[INPUT_FRAMES], csz[INPUT_FRAMES], uoff[INPUT_FRAMES], usz[INPUT_FRAMES];
+
+  if( s->midframe )
+    return 0;
+  if( s->inlen - s->inpos < INPUT_BUFFER/2 )
+    input_refill(s);
+
+  /*+++ Frames wholly in the buffer, laid out one after the other +++*/
+  nframes = 0;
+  total = 0;
+  p = s->inpos;
+  while( nframes < INPUT_FRAMES && input_frame_size(s, p, &csize, &usize) )
+    {
+      if( nframes > 0 && total + usize > INPUT_FRAME_MAX )
+	break;
+      coff[nframes] = p;
+      csz[nframes] = csize;
+      uoff[nframes] = total;
+      usz[nframes] = usize;
+      total += usize;
+      p += csize;
+      nframes++;
+    }//while
+
+  if( nframes == 0 )
+    return 0;
+  if( input_out_size(s, total) != 0 )
+    return -1;
+
+  nbad = 0;
+#pragma omp parallel for num_threads(read_threads()) schedule(dynamic, 1) reduction(+:nbad)
+  for(n=0; n<nframes; n++)
+    {
+      if( s->kind == COMPRESS_GZIP )
+	{
+	  z_stream zs;
+
+	  memset(&zs, 0, sizeof(zs));
+	  inflateInit2(&zs, 16 + MAX_WBITS);
+	  zs.next_in = s->in + coff[n];
+	  zs.avail_in = (uInt) csz[n];
+	  zs.next_out = (Bytef *) s->out + uoff[n];
+	  zs.avail_out = (uInt) usz[n];
+	  if( inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.avail_out != 0 )
+	    nbad++;
+	  inflateEnd(&zs);
+	}//if
+#ifdef HAVE_ZSTD
+      else if( ZSTD_isError(ZSTD_decompress(s->out + uoff[n], usz[n], s->in + coff[n], csz[n])) )
+	nbad++;
+#endif
+    }//for n
+
+  if( nbad > 0 )
+    {
+      printf("  * %d compressed frames of the data file are corrupted\n", nbad);
+      return -1;
+    }//if
+
+  s->inpos = p;
+  s->outpos = 0;
+  s->outlen = total;
+
+  return 1;
+}//input_fill_frames
+
+
+
+/*************************************************************************************
+NAME: input_fill_stream
+FUNCTION: Decompresses in order the next bytes of the frame being read, or of
+the next frame when it is not independent
+INPUT: stream
+RETURN: 1 if bytes were decompressed, 0 at the end of the file, -1 on a
+decompression error
+*************************************************************************************/
+int input_fill_stream(struct input_stream *s)
+{
+  int ret;
+  size_t produced;
+
+  if( input_out_size(s, INPUT_CHUNK) != 0 )
+    return -1;
+
+  produced = 0;
+  while( produced == 0 )
+    {
+      if( s->inpos == s->inlen )
+	input_refill(s);
+      if( s->inpos == s->inlen )
+	{
+	  if( s->midframe )
+	    printf("  * The compressed data file is truncated\n");
+	  return s->midframe ? -1 : 0;
+	}//if
+
+      if( s->kind == COMPRESS_GZIP )
+	{
+	  s->zs.next_in = s->in + s->inpos;
+	  s->zs.avail_in = (uInt) (s->inlen - s->inpos);
+	  s->zs.next_out = (Bytef *) s->out;
+	  s->zs.avail_out = (uInt) s->outsize;
+
+	  ret = inflate(&s->zs, Z_NO_FLUSH);
+	  if( ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR )
+	    {
+	      printf("  * The gzip data file is corrupted (%s)\n", s->zs.msg != NULL ? s->zs.msg : "inflate");
+	      return -1;
+	    }//if
+
+	  s->inpos = s->inlen - s->zs.avail_in;
+	  produced = s->outsize - s->zs.avail_out;
+	  s->midframe = ret != Z_STREAM_END;
+	  if( ret == Z_STREAM_END )
+	    inflateReset(&s->zs);
+	}//if
+#ifdef HAVE_ZSTD
+      else
+	{
+	  size_t left;
+	  ZSTD_inBuffer zin;
+	  ZSTD_outBuffer zout;
+
+	  zin.src = s->in;
+	  zin.size = s->inlen;
+	  zin.pos = s->inpos;
+	  zout.dst = s->out;
+	  zout.size = s->outsize;
+	  zout.pos = 0;
+
+	  left = ZSTD_decompressStream(s->zd, &zout, &zin);
+	  if( ZSTD_isError(left) )
+	    {
+	      printf("  * The zstd data file is corrupted (%s)\n", ZSTD_getErrorName(left));
+	      return -1;
+	    }//if
+
+	  s->inpos = zin.pos;
+	  produced = zout.pos;
+	  s->midframe = left != 0;
+	}//else
+#endif
+    }//while
+
+  s->outpos = 0;
+  s->outlen = produced;
+
+  return 1;
+}//input_fill_stream
+
+
+
+/*************************************************************************************
+NAME: input_cookie_read, input_cookie_seek, input_cookie_close
+FUNCTION: stdio functions of the decompressed stream. Seeks go forward only,
+decompressing and dropping the bytes skipped.
+INPUT: stream, as in fopencookie
+RETURN: as in fopencookie
+*************************************************************************************/
+ssize_t input_cookie_read(void *cookie, char *buf, size_t size)
+{
+  int status;
+  size_t n;
+  struct input_stream *s = (struct input_stream *) cookie;
+
+  while( s->outpos == s->outlen )
+    {
+      status = input_fill_frames(s);
+      if( status == 0 )
+	status = input_fill_stream(s);
+      if( status <= 0 )
+	return status;
+    }//while
+
+  n = s->outlen - s->outpos < size ? s->outlen - s->outpos : size;
+  memcpy(buf, s->out + s->outpos, n);
+  s->outpos += n;
+  s->pos += n;
+
+  return (ssize_t) n;
+}//input_cookie_read
+
+
+int input_cookie_seek(void *cookie, off64_t *offset, int whence)
+{
+  int status;
+  long int target;
+  size_t n;
+  struct input_stream *s = (struct input_stream *) cookie;
+
+  if( whence == SEEK_SET )
+    target = *offset;
+  else if( whence == SEEK_CUR )
+    target = s->pos + *offset;
+  else
+    return -1;
+
+  if( target < s->pos )
+    return -1;
+
+  while( s->pos < target )
+    {
+      if( s->outpos == s->outlen )
+	{
+	  status = input_fill_frames(s);
+	  if( status == 0 )
+	    status = input_fill_stream(s);
+	  if( status <= 0 )
+	    return -1;
+	}//if
+
+      n = s->outlen - s->outpos;
+      if( (long int) n > target - s->pos )
+	n = target - s->pos;
+      s->outpos += n;
+      s->pos += n;
+    }//while
+
+  *offset = s->pos;
+
+  return 0;
+}//input_cookie_seek
+
+
+int input_cookie_close(void *cookie)
+{
+  struct input_stream *s = (struct input_stream *) cookie;
+
+  if( s->kind == COMPRESS_GZIP )
+    inflateEnd(&s->zs);
+#ifdef HAVE_ZSTD
+  if( s->kind == COMPRESS_ZSTD )
+    ZSTD_freeDCtx(s->zd);
+#endif
+
+  fclose(s->raw);
+  free(s->in);
+  free(s->out);
+  free(s);
+
+  return 0;
+}//input_cookie_close
+
+
+
+/*************************************************************************************
+NAME: input_open
+FUNCTION: Opens a data file for reading, through the decompressor when it is
+compressed
+INPUT: file name
+RETURN: file, NULL if it can not be opened or its compression is not supported
+*************************************************************************************/
+FILE *input_open(char *filename)
+{
+  int kind;
+  FILE *pf=NULL;
+  struct input_stream *s=NULL;
+  cookie_io_functions_t io = {input_cookie_read, NULL, input_cookie_seek, input_cookie_close};
+
+  kind = input_compression(filename);
+  if( kind == COMPRESS_NONE )
+    return fopen(filename, "r");
+
+#ifndef HAVE_ZSTD
+  if( kind == COMPRESS_ZSTD )
+    {
+      printf("  * '%s' is compressed with zstd, build with HAVE_ZSTD (make zstd) to read it\n", filename);
+      return NULL;
+    }//if
+#endif
+
+  s = (struct input_stream *) calloc(1, sizeof(struct input_stream));
+  s->kind = kind;
+  s->raw = fopen(filename, "r");
+  s->in = (unsigned char *) malloc(INPUT_BUFFER);
+  if( s->raw == NULL || s->in == NULL )
+    {
+      if( s->raw != NULL )
+	fclose(s->raw);
+      free(s->in);
+      free(s);
+      return NULL;
+    }//if
+
+  if( kind == COMPRESS_GZIP )
+    inflateInit2(&s->zs, 16 + MAX_WBITS);
+#ifdef HAVE_ZSTD
+  if( kind == COMPRESS_ZSTD )
+    s->zd = ZSTD_createDCtx();
+#endif
+
+  pf = fopencookie(s, "r", io);
+  if( pf == NULL )
+    input_cookie_close(s);
+
+  return pf;
+}//input_open
@@ -0,0 +1,228 @@
+/******************************************************************************
+NAME: grid_storage
+FUNCTION: Structure-of-arrays storage of the grid. The fields integrated by
+the run are requested before the grid is allocated, and only those are
+kept in memory, one contiguous array of NTOTALCELLS doubles each (floats
+with STORAGE = float), or of the cells of a slab of columns when
+streaming. Cells are always addressed by their index in the whole grid,
+INDEX_C_ORDER(i,j,k). The sweep reads the fields through gp.view[], so a memory-mapped file (see
+mmap_reader.c) can be used in place of the arrays.
+INPUT: Requested fields, GV.NCELLS
+RETURN: gp.field[] arrays and gp.view[]
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: grid_field_name
+FUNCTION: Name of a grid field as it appears in the input files
+INPUT: field (GRID_*)
+RETURN: name
+*************************************************************************************/
+char *grid_field_name(int field)
+{
+  if( field == GRID_POTDOT )
+    return "potDot_r";
+  if( field == GRID_POTDOT_L_APP1 )
+    return "potDot_r_l_app1";
+  if( field == GRID_POTDOT_L_APP2 )
+    return "potDot_r_l_app2";
+
+  return "unknown";
+}//grid_field_name
+
+
+
+/*************************************************************************************
+NAME: grid_request_field
+FUNCTION: Marks a field to be allocated and filled by the readers
+INPUT: field (GRID_*)
+RETURN: 0
+*************************************************************************************/
+int grid_request_field(int field)
+{
+  gp.requested[field] = 1;
+
+  return 0;
+}//grid_request_field
+
+
+
+/*************************************************************************************
+NAME: grid_alloc
+FUNCTION: Allocates the requested fields for ncols columns, starting at column 0
+(GV.NCELLS^2 columns for the whole grid)
+INPUT: number of columns
+RETURN: 0, 1 if the memory could not be allocated
+*************************************************************************************/
+int grid_alloc(long int ncols)
+{
+  int f;
+  size_t ncells, size;
+
+  ncells = (size_t) ncols*GV.NCELLS;
+  size = GV.STORAGE == STORAGE_FLOAT ? sizeof(float) : sizeof(double);
+  gp.col0 = 0;
+  gp.ncols = ncols;
+  gp.bytes = 0;
+
+  for(f=0; f<GRID_NFIELDS; f++)
+    {
+      gp.field[f] = NULL;
+      gp.view[f].base = NULL;
+      gp.view[f].stride = size;
+      gp.view[f].single = GV.STORAGE == STORAGE_FLOAT;
+
+      if( !gp.requested[f] )
+	continue;
+
+      gp.field[f] = malloc(ncells*size);
+      if( gp.field[f] == NULL )
+	{
+	  printf("  * Not enough memory for the field %s\n", grid_field_name(f));
+	  return 1;
+	}//if
+
+      gp.view[f].base = (char *) gp.field[f];
+      gp.bytes += ncells*size;
+    }//for f
+
+  return 0;
+}//grid_alloc
+
+
+
+/*************************************************************************************
+NAME: grid_free
+FUNCTION: Frees the fields of the grid, or unmaps the binary file
+INPUT: none
+RETURN: none
+*************************************************************************************/
+void grid_free(void)
+{
+  int f;
+
+  for(f=0; f<GRID_NFIELDS; f++)
+    {
+      free(gp.field[f]);
+      gp.field[f] = NULL;
+      gp.view[f].base = NULL;
+    }//for f
+
+  if( gp.map != NULL )
+    munmap(gp.map, gp.mapbytes);
+  gp.map = NULL;
+  gp.mapbytes = 0;
+
+  gp.bytes = 0;
+}//grid_free
+
+
+
+/*************************************************************************************
+NAME: grid_store
+FUNCTION: Stores a value read for cell m in the grid filled by the readers (gread),
+if its field was requested, rounded to float with STORAGE = float
+INPUT: field (GRID_*), cell index, value
+RETURN: none
+*************************************************************************************/
+void grid_store(int field, long int m, double value)
+{
+  if( gread->field[field] == NULL )
+    return;
+
+  m = m - gread->col0*GV.NCELLS;
+  if( gread->view[field].single )
+    ((float *) gread->field[field])[m] = (float) value;
+  else
+    ((double *) gread->field[field])[m] = value;
+}//grid_store
+
+
+
+/*************************************************************************************
+NAME: grid_check_position
+FUNCTION: Compares the position read for cell m with the one derived from its
+(i,j,k) indices, since positions are not stored
+INPUT: cell index, position read
+RETURN: 0 if they agree to 1e-3 of a cell, 1 otherwise
+*************************************************************************************/
+int grid_check_position(long int m, double pos[3])
+{
+  long int i, j, k;
+  double tol;
+
+  i = m / ((long int) GV.NCELLS*GV.NCELLS);
+  j = (m / GV.NCELLS) % GV.NCELLS;
+  k = m % GV.NCELLS;
+
+  tol = 1e-3*GV.CellSize;
+
+  if( fabs(pos[X] - GRID_POS(i)) > tol ||
+      fabs(pos[Y] - GRID_POS(j)) > tol ||
+      fabs(pos[Z] - GRID_POS(k)) > tol )
+    return 1;
+
+  return 0;
+}//grid_check_position
+
+
+
+/*************************************************************************************
+NAME: grid_value
+FUNCTION: Value of a field in cell m, read through the view of the field
+INPUT: field (GRID_*), cell index
+RETURN: value
+*************************************************************************************/
+double grid_value(int field, long int m)
+{
+  float single;
+  double value;
+
+  m = m - gp.col0*GV.NCELLS;
+  if( gp.view[field].single )
+    {
+      memcpy(&single, gp.view[field].base + m*gp.view[field].stride, sizeof(float));
+      return single;
+    }//if
+
+  memcpy(&value, gp.view[field].base + m*gp.view[field].stride, sizeof(double));
+
+  return value;
+}//grid_value
+
+
+
+/*************************************************************************************
+NAME: grid_gather
+FUNCTION: Copies n consecutive cells of a field, starting at cell m. Arrays are
+copied with one memcpy, floats are widened to double; strided views (packed
+records, maybe unaligned) value by value.
+INPUT: field (GRID_*), first cell, number of cells, destination
+RETURN: none
+*************************************************************************************/
+void grid_gather(int field, long int m, int n, double *dest)
+{
+  int k;
+  char *src;
+  size_t stride;
+
+  m = m - gp.col0*GV.NCELLS;
+  src = gp.view[field].base + m*gp.view[field].stride;
+  stride = gp.view[field].stride;
+
+  if( gp.view[field].single )
+    {
+      for(k=0; k<n; k++)
+	dest[k] = ((float *) src)[k];
+      return;
+    }//if
+
+  if( stride == sizeof(double) )
+    {
+      memcpy(dest, src, (size_t) n*sizeof(double));
+      return;
+    }//if
+
+  for(k=0; k<n; k++)
+    memcpy(&dest[k], src + k*stride, sizeof(double));
+}//grid_gather
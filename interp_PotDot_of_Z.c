@@ -31,19 +31,22 @@ axis for fixed "x" and "y".
 
 double fill_potdot_xy(int i, int j)
 {  
-  int m, k;
+  int k;
+  long int m;
   
   for(k=0; k<GV.NCELLS; k++)
     { 
       m = INDEX_C_ORDER(i,j,k);
       
-      z_depth[k] = gp[m].pos[Z];
-      PotDot[k]  = gp[m].potDot_r;
+      z_depth[k] = GRID_POS(k);
+      PotDot[k]  = grid_value(GRID_POTDOT, m);
     }//for k 
     
   z_depth[0] = 0.0;
   z_depth[GV.NCELLS-1] = 400.0;
 
+  column_interp_build(&PotDot_interp, z_depth, PotDot);
+
   return 0;
   
 }//fill_potdot_xy
@@ -51,25 +54,11 @@ double fill_potdot_xy(int i, int j)
 
 
 /*************************************************************************************
-                             Performing interpolation
+         Performing interpolation with the interpolant built in fill_potdot_xy
 *************************************************************************************/
 double potdot_xy(double zeval)
 {
-  double PotDot_ofZ;
-  gsl_interp_accel *acc;
-  gsl_spline *linearInterp;
-  
-  acc = gsl_interp_accel_alloc();
-  linearInterp = gsl_spline_alloc(gsl_interp_linear, (size_t) GV.NCELLS );
-  gsl_spline_init( linearInterp, z_depth, PotDot, (size_t) GV.NCELLS );
-  
-  PotDot_ofZ = gsl_spline_eval(linearInterp, zeval, acc);
-  
-  gsl_spline_free(linearInterp);
-  gsl_interp_accel_free(acc);
-    
-  return PotDot_ofZ;
-  
+  return column_interp_eval(&PotDot_interp, zeval);
 }//potdot_xy
 
 
@@ -89,43 +78,7 @@ double integrando(double z, void *params)
 *************************************************************************************/
 double simpson(double a, double b, int Nsamples)
 {
-  double min,max;
-  double x0, f0, hstep, feven, fodd, xn, fn, integ, xie, xio;
-  int i;
-  
-  max = b;
-  min = a;
-  
-  hstep = (max-min)/(Nsamples*1.0);
-  
-  x0 = min;
-  f0 = potdot_xy(x0);
-  
-  feven = 0.0;
-  xie = x0 + 2.0*hstep;
-
-  for(i=2; i<=(Nsamples-2); i=i+2)
-    {
-      feven = feven + potdot_xy(xie);
-      xie = xie + 2.0*hstep;
-    }//for i
-  
-
-  fodd = 0.0;
-  xio = x0 + hstep;
-
-  for(i=1; i<=Nsamples-1; i=i+2)
-    {
-      fodd = fodd + potdot_xy(xio);
-      xio = xio + 2.0*hstep;
-    }//for i
-  
-  xn = max;
-  fn = potdot_xy(xn);
-  
-  integ = (hstep/3.0)*(f0 + 2.0*feven + 4.0*fodd + fn);
-  
-  return integ;
+  return simpson_column(&PotDot_interp, a, b, Nsamples);
 }//simpson
 
 
@@ -150,7 +103,7 @@ double SW_integral(void)
   //gsl_integration_qags(&F, lowerLimit, upperLimit, 1e-3, 1e-3, 10000, w, &result, &error);
   //gsl_integration_qag(&F, lowerLimit, upperLimit, 1e-3, 1e-3, 10000, 6, w, &result, &error);
   
-  result = simpson(lowerLimit, upperLimit, INTEGRATION_NSTEPS);
+  result = integrate_column(&PotDot_interp, lowerLimit, upperLimit, &GV.IntegCheckMaxDiff);
     
   //printf("result = %20.8lf\n", result);
   
@@ -162,43 +115,43 @@ double SW_integral(void)
 
 
 /*************************************************************************************
-                              Computing dT_dr
+NAME: dT_dr_column
+FUNCTION: Depth profile of the current column. T_depth[k] is the integral from
+the lower edge of cell k, k*CellSize, to zmax. Instead of one integral per
+cell, the profile is built in one backward pass: T_depth[N-1] is integrated
+over the last cell and every T_depth[k] is T_depth[k+1] plus the integral
+over cell k, with INTEGRATION_NSTEPS/N Simpson intervals per cell (or the
+closed form). As before DeltaT[k] = T_depth[k+1] - T_depth[k], with
+DeltaT[N-1] = T_depth[N-1], and dT_dr[k] = DeltaT[k]/(zmax/N).
+INPUT: interpolant of the column, upper limit, buffers of NCELLS values, largest
+difference in INTEG_CHECK mode
+RETURN: 0
 *************************************************************************************/
-double *dT_dr_integ(int i, int j)
+int dT_dr_column(struct column_interp *ci, double zmax, double *T_depth, double *dT_dr, double *checkdiff)
 {
-  double *T_depth=NULL, *DeltaT=NULL, *dT_dr=NULL;
-  double nx, ny, nz;
-  int m, n, k;
+  int k, nz, Nsamples;
+  double DeltaT;
 
-  nx = ny = nz = GV.NCELLS;
+  nz = GV.NCELLS;
 
-  T_depth  = (double *) malloc((size_t) (nz)*sizeof(double));
-  DeltaT   = (double *) malloc((size_t) (nz)*sizeof(double));
-  dT_dr    = (double *) malloc((size_t) (nz)*sizeof(double));
+  Nsamples = 2*(INTEGRATION_NSTEPS/(2*nz));
+  if( Nsamples < 2 )
+    Nsamples = 2;
 
+  T_depth[nz-1] = integrate_column_n(ci, GRID_POS(nz-1)-GV.CellStep, zmax, Nsamples, checkdiff);
+  for( k=(nz-2); k>=0; --k )
+    T_depth[k] = T_depth[k+1] + integrate_column_n(ci, GRID_POS(k)-GV.CellStep, GRID_POS(k+1)-GV.CellStep,
+						   Nsamples, checkdiff);
 
-  for( k=(nz-1); k>=0; --k )
+  for( k=0; k<nz; k++ )
     {
-      m = (k * ny + j) * nx + i; 
-      
-      T_depth[k] = simpson(gp[m].pos[Z]-GV.CellStep, 400.0, INTEGRATION_NSTEPS);
-      
       if(k==(nz-1))
-	{
-	  DeltaT[k] = T_depth[k];
-	}//if
+	DeltaT = T_depth[k];
       else
-	{
-	  DeltaT[k] = T_depth[k+1] - T_depth[k];
-	}//else
-      
-      dT_dr[k] = DeltaT[k] / ( (double) (400.0 / (double) (GV.NCELLS)) );
-      
-      //printf("m=%d i=%d j=%d k=%d posZ=%lf T_depth=%lf DeltaT=%lf dT_dr=%lf\n", m, i, j, k, gp[m].pos[Z], T_depth[k], DeltaT[k], dT_dr[k]);
-    }//for k
+	DeltaT = T_depth[k+1] - T_depth[k];
 
-  free(T_depth);
-  free(DeltaT);
+      dT_dr[k] = DeltaT / (zmax / (double) nz);
+    }//for k
 
-  return dT_dr;
-}//dT_dr
+  return 0;
+}//dT_dr_column
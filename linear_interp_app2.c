@@ -19,19 +19,22 @@ axis for fixed "x" and "y".
 
 double fill_potdot_l_xy_app2(int i, int j)
 {
-  int k, m, n;
+  int k;
+  long int m;
 
   for(k=0; k<GV.NCELLS; k++)
     { 
       m = INDEX_C_ORDER(i,j,k) ;
 
-      z_depth[k] = gp[m].pos[Z];
-      PotDot_l_app2[k]  = gp[m].potDot_r_l_app2;
+      z_depth[k] = GRID_POS(k);
+      PotDot_l_app2[k]  = grid_value(GRID_POTDOT_L_APP2, m);
     }//for k
 
   z_depth[0] = 0.0;
   z_depth[GV.NCELLS-1] = GV.BoxSize;
 
+  column_interp_build(&PotDot_l_app2_interp, z_depth, PotDot_l_app2);
+
   return 0;
 
 }//fill_potdot_l_xy
@@ -41,23 +44,7 @@ double fill_potdot_l_xy_app2(int i, int j)
 /*Performing interpolation*/
 double linear_potdot_xy_app2(double zeval)
 {
-  double PotDot_ofZ_l_app2; 
-
-  gsl_interp_accel *acc;
-  gsl_spline *linearInterp;
-
-  
-  acc = gsl_interp_accel_alloc();
-  linearInterp = gsl_spline_alloc( gsl_interp_linear, (size_t) GV.NCELLS );
-  gsl_spline_init( linearInterp, z_depth, PotDot_l_app2, (size_t) GV.NCELLS );
-
-  PotDot_ofZ_l_app2 = gsl_spline_eval(linearInterp, zeval, acc);
-
-  gsl_spline_free(linearInterp);
-  gsl_interp_accel_free(acc);
-
-  return PotDot_ofZ_l_app2;
-
+  return column_interp_eval(&PotDot_l_app2_interp, zeval);
 }//linear_pot_dot
 
 
@@ -72,41 +59,7 @@ double integrando_l_app2(double z, void *params)
 
 double simpson_l_app2(double a, double b, int Nsamples)
 {
-  double min,max;
-  double x0, f0, hstep, feven, fodd, xn, fn, integ_l_app2, xie, xio;
-  int i;
-  
-  max = b;
-  min = a;
-  
-  hstep = (max-min)/(Nsamples*1.0);
-  
-  x0 = min;
-  f0 = linear_potdot_xy_app2(x0);
-  
-  feven = 0.0;
-  xie = x0 + 2.0*hstep;
-  for(i=2; i<=(Nsamples-2); i=i+2)
-    {
-      feven = feven + linear_potdot_xy_app2(xie);
-      xie = xie + 2.0*hstep;
-    }
-  
-  fodd = 0.0;
-  xio = x0 + hstep;
-  for(i=1; i<=Nsamples-1; i=i+2)
-    {
-      fodd = fodd + linear_potdot_xy_app2(xio);
-      xio = xio + 2.0*hstep;
-    }
-  
-  xn = max;
-  fn = linear_potdot_xy_app2(xn);
-  
-  integ_l_app2 = (hstep/3.0)*(f0 + 2.0*feven + 4.0*fodd + fn);
-  
-  return integ_l_app2;
-  
+  return simpson_column(&PotDot_l_app2_interp, a, b, Nsamples);
 }//simpson_l
 
 
@@ -118,7 +71,7 @@ double SW_integral_l_app2(void)
   lowerLimit = 0.0;
   upperLimit = GV.BoxSize;
 
-  result_l_app2 = simpson_l_app2(lowerLimit, upperLimit, INTEGRATION_NSTEPS);
+  result_l_app2 = integrate_column(&PotDot_l_app2_interp, lowerLimit, upperLimit, &GV.IntegCheckMaxDiff);
    
   return result_l_app2;
 
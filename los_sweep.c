@@ -0,0 +1,203 @@
+/******************************************************************************
+NAME: los_sweep
+FUNCTION: SW maps projected along an arbitrary line of sight LOS. Pixel
+(i,j) of the map is a ray starting at GRID_POS(i)*u + GRID_POS(j)*v, with
+(u,v) an orthonormal basis of the plane perpendicular to the line of
+sight, and going along it through the periodic box. Every registered
+field is sampled trilinearly at the NCELLS points GRID_POS(k) of the ray,
+which then takes the place of a column: it is interpolated and integrated
+between 0 and zmax exactly as the z columns (column_interp.c), so every
+INTEGRATION and INTERP choice applies. The rays are taken in bundles of
+RAY_BUNDLE x RAY_BUNDLE neighbouring pixels that step through the box
+together, so at every step the bundle reads a small block of the grid.
+The maps go to the same outputs as the maps along z, with (x,y) the
+coordinates of the pixel in the (u,v) plane.
+INPUT: The whole grid gp, GV.LOS
+RETURN: One map per registered field
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: los_basis
+FUNCTION: Normalises the line of sight and builds the basis (u,v) of the plane of
+the map, with u, v, LOS right-handed and u = x, v = y for a line of sight along z
+INPUT: None
+RETURN: 0, 1 if the line of sight is the null vector
+*************************************************************************************/
+int los_basis(void)
+{
+  int a;
+  double norm, axis[3], dot;
+
+  norm = sqrt(GV.LOS[X]*GV.LOS[X] + GV.LOS[Y]*GV.LOS[Y] + GV.LOS[Z]*GV.LOS[Z]);
+  if( !(norm > 0.0) )
+    {
+      printf("  * The line of sight can not be the null vector\n");
+      return 1;
+    }//if
+
+  for(a=0; a<3; a++)
+    GV.LOS[a] = GV.LOS[a]/norm;
+
+  /*+++ u: the x axis, or the y axis for lines of sight close to x, minus its part along LOS +++*/
+  axis[X] = fabs(GV.LOS[X]) < 0.9 ? 1.0 : 0.0;
+  axis[Y] = fabs(GV.LOS[X]) < 0.9 ? 0.0 : 1.0;
+  axis[Z] = 0.0;
+
+  dot = axis[X]*GV.LOS[X] + axis[Y]*GV.LOS[Y];
+  for(a=0; a<3; a++)
+    GV.LOS_U[a] = axis[a] - dot*GV.LOS[a];
+
+  norm = sqrt(GV.LOS_U[X]*GV.LOS_U[X] + GV.LOS_U[Y]*GV.LOS_U[Y] + GV.LOS_U[Z]*GV.LOS_U[Z]);
+  for(a=0; a<3; a++)
+    GV.LOS_U[a] = GV.LOS_U[a]/norm;
+
+  /*+++ v = LOS x u +++*/
+  GV.LOS_V[X] = GV.LOS[Y]*GV.LOS_U[Z] - GV.LOS[Z]*GV.LOS_U[Y];
+  GV.LOS_V[Y] = GV.LOS[Z]*GV.LOS_U[X] - GV.LOS[X]*GV.LOS_U[Z];
+  GV.LOS_V[Z] = GV.LOS[X]*GV.LOS_U[Y] - GV.LOS[Y]*GV.LOS_U[X];
+
+  return 0;
+}//los_basis
+
+
+
+/*************************************************************************************
+NAME: los_along_z
+FUNCTION: Tells if the line of sight is the z axis, integrated by the column sweep
+INPUT: None
+RETURN: 1 if LOS = (0,0,1), 0 otherwise
+*************************************************************************************/
+int los_along_z(void)
+{
+  return GV.LOS[X] == 0.0 && GV.LOS[Y] == 0.0 && GV.LOS[Z] > 0.0;
+}//los_along_z
+
+
+
+/*************************************************************************************
+NAME: trilinear_cells
+FUNCTION: Cells and weights of the trilinear interpolation at a point of the
+periodic box, the cell values being at the centres GRID_POS
+INPUT: position, indices of the 8 cells, weights of the 8 cells
+RETURN: 0
+*************************************************************************************/
+int trilinear_cells(double pos[3], long int m[8], double w[8])
+{
+  int a, c, lo[3], hi[3];
+  double p, t[3];
+
+  for(a=0; a<3; a++)
+    {
+      p = pos[a]/GV.CellSize - 0.5;
+      lo[a] = (int) floor(p);
+      t[a] = p - lo[a];
+
+      lo[a] = lo[a] % GV.NCELLS;
+      if( lo[a] < 0 )
+	lo[a] += GV.NCELLS;
+      hi[a] = (lo[a] + 1) % GV.NCELLS;
+    }//for a
+
+  for(c=0; c<8; c++)
+    {
+      m[c] = INDEX_C_ORDER(c & 4 ? hi[X] : lo[X],
+			   c & 2 ? hi[Y] : lo[Y],
+			   c & 1 ? hi[Z] : lo[Z]);
+      w[c] = (c & 4 ? t[X] : 1.0 - t[X])*(c & 2 ? t[Y] : 1.0 - t[Y])*(c & 1 ? t[Z] : 1.0 - t[Z]);
+    }//for c
+
+  return 0;
+}//trilinear_cells
+
+
+
+/*************************************************************************************
+NAME: sweep_SW_los
+FUNCTION: Computes a_SF times the SW integral between 0 and zmax along the rays of
+the line of sight, for all the registered fields. Ray c = i*NCELLS + j goes to
+SW_map[c], and its dT/dr profile, if requested, to dT_dr[c*NCELLS + k].
+A bundle is skipped when all its rays are in the checkpoint of an earlier run.
+INPUT: none
+RETURN: 0
+*************************************************************************************/
+int sweep_SW_los(void)
+{
+  long int b, nbundles1d;
+
+  nbundles1d = (GV.NCELLS + RAY_BUNDLE - 1)/RAY_BUNDLE;
+
+#pragma omp parallel
+  {
+    struct column_workspace own, *ws;
+    int i, j, k, f, a, r, c8, nrays, i0, j0;
+    long int m[8];
+    double t0, s, pos[3], w[8], value, *rays;
+
+    ws = column_workspace_take(&own);
+    rays = (double *) malloc((size_t) RAY_BUNDLE*RAY_BUNDLE*NSWFIELDS*GV.NCELLS*sizeof(double));
+    t0 = report_time();
+
+#pragma omp for schedule(dynamic, 1) nowait
+    for(b=0; b<nbundles1d*nbundles1d; b++)
+      {
+	i0 = (b / nbundles1d)*RAY_BUNDLE;
+	j0 = (b % nbundles1d)*RAY_BUNDLE;
+
+	nrays = 0;
+	for(i=i0; i<i0+RAY_BUNDLE && i<GV.NCELLS; i++)
+	  for(j=j0; j<j0+RAY_BUNDLE && j<GV.NCELLS; j++)
+	    nrays += !checkpoint_done((long int) i*GV.NCELLS + j);
+	if( nrays == 0 )
+	  continue;
+
+	/*+++ All the rays of the bundle step together through the box +++*/
+	for(k=0; k<GV.NCELLS; k++)
+	  {
+	    s = GRID_POS(k);
+	    nrays = 0;
+
+	    for(i=i0; i<i0+RAY_BUNDLE && i<GV.NCELLS; i++)
+	      for(j=j0; j<j0+RAY_BUNDLE && j<GV.NCELLS; j++)
+		{
+		  for(a=0; a<3; a++)
+		    pos[a] = GRID_POS(i)*GV.LOS_U[a] + GRID_POS(j)*GV.LOS_V[a] + s*GV.LOS[a];
+
+		  trilinear_cells(pos, m, w);
+
+		  for(f=0; f<NSWFIELDS; f++)
+		    {
+		      value = 0.0;
+		      for(c8=0; c8<8; c8++)
+			value = value + w[c8]*grid_value(SWF[f].field, m[c8]);
+		      rays[(nrays*NSWFIELDS + f)*GV.NCELLS + k] = value;
+		    }//for f
+
+		  nrays++;
+		}//for j
+	  }//for k
+
+	/*+++ Every ray is then integrated as a column +++*/
+	r = 0;
+	for(i=i0; i<i0+RAY_BUNDLE && i<GV.NCELLS; i++)
+	  for(j=j0; j<j0+RAY_BUNDLE && j<GV.NCELLS; j++)
+	    {
+	      memcpy(ws->PotDot, &rays[r*NSWFIELDS*GV.NCELLS], (size_t) NSWFIELDS*GV.NCELLS*sizeof(double));
+
+	      for(f=0; f<NSWFIELDS; f++)
+		integrate_sw_field(ws, f, (long int) i*GV.NCELLS + j);
+
+	      checkpoint_mark((long int) i*GV.NCELLS + j, 1);
+	      r++;
+	    }//for j
+
+	report_columns(r);
+      }//for b
+
+    report_busy(t0);
+    free(rays);
+    column_workspace_give(ws, &own);
+  }//omp parallel
+
+  return 0;
+}//sweep_SW_los
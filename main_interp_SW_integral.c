@@ -1,9 +1,33 @@
 /****************************************************************************************************
                        HEADERS
 ****************************************************************************************************/
+#define _GNU_SOURCE //fopencookie, for the compressed data files
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_spline.h>
 #include <gsl/gsl_interp.h>
@@ -21,10 +45,25 @@ extern double *z_depth=NULL, *PotDot=NULL, *PotDot_l_app1=NULL, *PotDot_l_app2=N
                        INCLUDING SUPPORT FILES
 *************************************************************************************/
 #include "variables.c"
+#include "run_report.c"
+#include "grid_storage.c"
+#include "ascii_parser.c"
+#include "compressed_input.c"
 #include "reading.c"
+#include "mmap_reader.c"
+#include "column_interp.c"
+#include "simd_quadrature.c"
 #include "interp_PotDot_of_Z.c"
 #include "linear_interp_app1.c"
 #include "linear_interp_app2.c"
+#include "output_writer.c"
+#include "checkpoint.c"
+#include "column_sweep.c"
+#include "los_sweep.c"
+#include "streaming.c"
+#include "sky_sweep.c"
+#include "mpi_decomposition.c"
+#include "batch.c"
 
 
 
@@ -37,167 +76,255 @@ RETURN: none
 
 int main(int argc, char *argv[])
 {
-  int i, j, k, n, m;
-  double z, *dT_dr=NULL; 
+  int status;
+  long int col0, ncols, nunits, ndone;
   char *infile=NULL;
-  FILE *pf=NULL;
-  FILE *pf1=NULL;
-  char buff[1000];
 
 
+  report_start();
+  mpi_start(&argc, &argv);
+
   if(argc < 2)
     {
       printf("Error: Incomplete number of parameters. Execute as follows:\n");
-      printf("%s Parameters_file\n", argv[0]);
+      printf("%s Parameters_file [Parameters_file ...]\n", argv[0]);
+      printf("Several parameters files are run as a batch of snapshots\n");
       exit(0);      
     }//if
+
+  /*+++++ Batch of snapshots +++++*/
+  if( argc > 2 )
+    {
+      status = batch_SW_maps(argc-1, &argv[1]);
+      mpi_stop();
+      return status;
+    }//if
     
   infile = argv[1];
   
   /*+++++ Reading parameters +++++*/
   printf("Reading parameters file\n");
   printf("-----------------------------------------\n");
-  read_parameters( infile );
+  report_begin(PHASE_PARAMETERS);
+  if( mpi_read_parameters( infile ) != 0 )
+    {
+      mpi_stop();
+      return 0;
+    }//if
+  report_end(PHASE_PARAMETERS);
 
   /*+++ Other variables +++*/
-  GV.ZERO         = 1e-30;
-  GV.NTOTALCELLS  = GV.NCELLS*GV.NCELLS*GV.NCELLS;
-  GV.CellSize     = GV.BoxSize/(1.0*GV.NCELLS);
-  GV.c_SL = 299792.458; // km/s
-  GV.CMB_T0 = 2725480; // micro K
-  GV.CellStep = GV.CellSize / 2.0;
+  derived_parameters();
   
   printf("NCells=%d\n", GV.NCELLS);
-  printf("--------------------------------------------------\n");
-  
-  /*+++ Memory allocation +++*/
-  gp     = (struct grid *) malloc((size_t) GV.NTOTALCELLS*sizeof(struct grid));
-  printf("Memory allocated!\n");
-  printf("--------------------------------------------------\n");
-  
-
-  /*+++++ Reading datafile +++++*/
-  printf("Reading the file...\n");
-  printf("-----------------------------------------\n");
-#ifdef BINARYDATA
-  read_binary();
+  printf("Input=%s\n", GV.INPUT_FORMAT == INPUT_BINARY ? "binary" : "ascii");
+#ifdef _OPENMP
+  printf("Threads=%d\n", omp_get_max_threads());
 #endif
-  
-#ifdef ASCIIDATA
-  read_data(GV.FILENAME);
+#ifdef USE_MPI
+  printf("Processes=%d\n", GV.NPROCS);
 #endif
+  column_interp_kind_check();
+  simpson_batch_select();
 
-  printf("File read!\n");
-  printf("--------------------------------------------------\n");
-      
+  /*+++ Line of sight, the z axis unless LOS says otherwise +++*/
+  if( los_basis() != 0 )
+    exit(0);
+  if( GV.SKY_NSIDE > 0 )
+    {
+      /*+++ Full sky: radial rays, one map of 12 NSIDE^2 pixels per field +++*/
+      if( GV.SWEEP_MODE == SWEEP_STREAM )
+	printf("  * Rays cross the whole box, the grid is read at once instead of streamed\n");
+      if( GV.DT_DR_OUTPUT )
+	printf("  * DT_DR is not available for full-sky maps\n");
+      GV.SWEEP_MODE = SWEEP_GRID;
+      GV.DT_DR_OUTPUT = 0;
+    }//if
+  else if( !los_along_z() )
+    {
+      printf("Line of sight=(%lf, %lf, %lf)\n", GV.LOS[X], GV.LOS[Y], GV.LOS[Z]);
+      if( GV.SWEEP_MODE == SWEEP_STREAM )
+	{
+	  printf("  * Rays cross the whole box, the grid is read at once instead of streamed\n");
+	  GV.SWEEP_MODE = SWEEP_GRID;
+	}//if
+    }//if
+
+  /*+++ Processes: rays need the whole grid, columns are split among them +++*/
+  if( GV.SKY_NSIDE > 0 || !los_along_z() )
+    {
+      if( mpi_whole_grid() != 0 )
+	{
+	  mpi_stop();
+	  return 0;
+	}//if
+    }//if
+  else if( GV.NPROCS > 1 && GV.SWEEP_MODE == SWEEP_STREAM )
+    {
+      printf("  * Every process holds only its columns, the grid is read at once instead of streamed\n");
+      GV.SWEEP_MODE = SWEEP_GRID;
+    }//else if
 
+  /*+++ The adaptive quadrature reports failures instead of aborting +++*/
+  if( GV.INTEG_MODE == INTEG_ADAPTIVE )
+    gsl_set_error_handler_off();
+  printf("--------------------------------------------------\n");
+  
+  /*+++ BoxSize and cosmology come from the header of the binary file +++*/
+  if( GV.INPUT_FORMAT == INPUT_BINARY && read_binary_header() != 0 )
+    exit(0);
+  
+  
   //---------------------------------------------------------  
-  /*Interpolation of values from exact PotDot*/
+  /*Fields integrated along z*/
   //---------------------------------------------------------    
-  z_depth = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
-  PotDot  = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
-  
-  
-  pf = fopen( "./SW_Integral_Exact_sln.dat", "w" );
-  fprintf(pf, "#n\t i\t j\t x\t y\t SW_Integral\n");
-
-   for(i=0; i<GV.NCELLS; i++)
-     {                                                                                                          
-       for(j=0; j<GV.NCELLS; j++)                                                                                
-	 {                                                                                                       
-	   n = INDEX_C_2D(i,j);                                                                                  
-	   fill_potdot_xy(i, j); // this one builtds pot_dot(z)                                                  
-	   	   
-	   fprintf( pf,                                                                                          
-		    "%12d %12d %12d %16.8f %16.8f %16.8f\n",                                                     
-                   n, i, j, gp[n].pos[X], gp[n].pos[Y], GV.a_SF*SW_integral() );                                
-	 }//for j 
-     }//for i
-   
-   fclose(pf);
-      
-   free(z_depth);
-   free(PotDot);
-   
-   printf("Interpolation finished\n");
-   printf("-----------------------------------------\n");
-       
+  register_data_fields(GV.INPUT_FORMAT == INPUT_ASCII);
+  
   
   //---------------------------------------------------------  
-  /*Interpolation of values in linear regime with the first approximation to f(t)*/
+  /*Streaming: slabs of columns are read, integrated and written*/
   //---------------------------------------------------------    
-  printf("Beginning interpolation of values from the first linear approximation to f(t) proportional to 1/Omega_L0\n");
+  if( GV.SWEEP_MODE == SWEEP_STREAM )
+    {
+      printf("Beginning streaming interpolation of %d fields\n", NSWFIELDS);
+      printf("--------------------------------------------------\n");
+      
+      if( GV.CHECKPOINT > 0.0 || GV.RESTART )
+	printf("  * SWEEP = stream writes every slab as it goes, it is not checkpointed\n");
+
+      if( stream_SW_maps(GV.STREAM_COLUMNS) != 0 )
+	exit(1);
+      
+      print_sw_summary("Interpolation");
+      
+      printf("-----------------------------------------\n");
+      printf("Code finished!\n");  
+      printf("-----------------------------------------\n");
+      
+      mpi_stop();
+      return 0;
+    }//if
+  
+  
+  /*+++ Memory allocation, only for the registered fields and the columns of this process +++*/
+  mpi_columns(&col0, &ncols);
+  report_begin(PHASE_ALLOC);
+  if( GV.INPUT_FORMAT == INPUT_BINARY && GV.BINARY_READER == READER_MMAP )
+    {
+      /*+++ The binary file is read in place, nothing to allocate +++*/
+      if( grid_map_binary(col0, ncols) != 0 )
+	exit(0);
+      printf("File mapped! %.3lf MB\n", gp.mapbytes/1048576.0);
+    }//if
+  else
+    {
+      if( grid_alloc(ncols) != 0 )
+	exit(0);
+      gp.col0 = col0;
+      printf("Memory allocated! %.3lf MB\n", gp.bytes/1048576.0);
+    }//else
+  report_end(PHASE_ALLOC);
   printf("--------------------------------------------------\n");
   
-  z_depth   = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
-  PotDot_l_app1  = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
-
 
-  pf = fopen( "./SWIntegral_LApp1.dat", "w" );
-  fprintf(pf, "#n\t i\t j\t x\t y\t z\t SW_Integral_l\n");
+  /*+++ Maps, with the columns of the last checkpoint when restarting +++*/
+  nunits = GV.SKY_NSIDE > 0 ? 12*GV.SKY_NSIDE*GV.SKY_NSIDE : gp.ncols;
+  sw_maps_alloc(nunits);
+  ndone = checkpoint_start(nunits);
 
-  for(i=0; i<GV.NCELLS; i++)
+  /*+++++ Reading datafile +++++*/
+  if( ndone < nunits )
     {
-      for(j=0; j<GV.NCELLS; j++)
+      printf("Reading the file...\n");
+      printf("-----------------------------------------\n");
+      report_begin(PHASE_READ);
+      if( GV.INPUT_FORMAT == INPUT_BINARY )
 	{
-	  n = INDEX_C_2D(i, j);
-	  fill_potdot_l_xy_app1(i, j);
-	  	  
-	  fprintf(pf,"%d %d %d %f %f %f\n", 
-		  n, i, j, 
-		  gp[n].pos[X], gp[n].pos[Y], GV.a_SF*SW_integral_l_app1());
-	  
-	}//for j      
-    }//for i  
-
-  fclose(pf);
-
-
-  free(z_depth);
-  free(PotDot_l_app1);
-
-  printf("Interpolation of values from first linear approx. finished!\n");
-  printf("-----------------------------------------\n");
-   
+	  if( GV.BINARY_READER == READER_FREAD && read_binary(GV.FILENAME) != 0 )
+	    exit(1);
+	}//if
+      else if( read_data(GV.FILENAME) != 0 )
+	exit(1);
+      report_end(PHASE_READ);
 
+      printf("File read!\n");
+    }//if
+  else
+    printf("All the columns are in the checkpoint, the file is not read\n");
+  printf("--------------------------------------------------\n");
+      
 
   //---------------------------------------------------------  
-  /*Interpolation of values in linear regime with the second approximation to f (f_app2)*/
-  //---------------------------------------------------------  
-  
-  printf("Beginning interpolation of values from the second linear approximation to f(t) proportional to Omega_M(a)\n");
-  printf("-----------------------------------------\n");
+  /*Interpolation and integration of all the fields in one sweep*/
+  //---------------------------------------------------------    
+  printf("Beginning interpolation of %d fields\n", NSWFIELDS);
+  printf("--------------------------------------------------\n");
   
-  z_depth   = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
-  PotDot_l_app2  = (double *) malloc((size_t) GV.NCELLS*sizeof(double));
-
-  pf = fopen( "./SWIntegral_LApp2.dat", "w" );
-  fprintf(pf, "#n\t i\t j\t x\t y\t z\t SW_Integral_l_app2\n");
-
-  for(i=0; i<GV.NCELLS; i++)
+  if( GV.SKY_NSIDE > 0 )
     {
-      for(j=0; j<GV.NCELLS; j++)
-	{
-	  n = INDEX_C_2D(i,j);
-	  fill_potdot_l_xy_app2(i, j);
-	    
-	  fprintf(pf,"%d %d %d %f %f %f\n", 
-		  n, i, j, 
-		  gp[n].pos[X], gp[n].pos[Y], GV.a_SF*SW_integral_l_app2());
-	}//for j      
-    }//for i  
-
-  fclose(pf);
-
-  free(z_depth);
-  free(PotDot_l_app2);
+      report_begin(PHASE_INTEGRATE);
+      report_progress_start(nunits, "pixels");
+      report_progress(ndone);
+      sweep_SW_sky();
+      report_progress_end();
+      checkpoint_flush();
+      report_end(PHASE_INTEGRATE);
 
+      report_begin(PHASE_OUTPUT);
+      if( write_sky_maps() != 0 )
+	exit(0);
+      checkpoint_end(0);
+      report_end(PHASE_OUTPUT);
+      
+      print_sw_summary("Sky map");
+      
+      sw_maps_free();
+      grid_free();
+      
+      printf("-----------------------------------------\n");
+      printf("Code finished!\n");  
+      printf("-----------------------------------------\n");
+      
+      mpi_stop();
+      return 0;
+    }//if
+  
+  report_begin(PHASE_INTEGRATE);
+  if( los_along_z() )
+    {
+      report_progress_start(nunits, "columns");
+      report_progress(ndone);
+      sweep_SW_maps();
+    }//if
+  else
+    {
+      report_progress_start(nunits, "rays");
+      report_progress(ndone);
+      sweep_SW_los();
+    }//else
+  report_progress_end();
+  checkpoint_flush();
+  mpi_reduce_stats();
+  report_end(PHASE_INTEGRATE);
 
-  printf("Interpolation of values from second linear approx. finished!\n");
+  report_begin(PHASE_OUTPUT);
+  if( mpi_output_maps() != 0 )
+    exit(0);
+  checkpoint_end(0);
+  report_end(PHASE_OUTPUT);
+  
+  print_sw_summary("Interpolation");
+  
+  sw_maps_free();
+  
   printf("-----------------------------------------\n");
     
   
+  grid_free();
+
   printf("Code finished!\n");  
   printf("-----------------------------------------\n");
 
+  mpi_stop();
+  return 0;
 }//main
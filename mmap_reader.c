@@ -0,0 +1,114 @@
+/******************************************************************************
+NAME: mmap_reader
+FUNCTION: Zero-copy reader of the binary data file. The file is mapped in
+memory and the fields are read in place from the packed records through
+strided views (gp.view[]), so the column sweep reads straight from the
+page cache without copying the file into the grid.
+INPUT: GV.FILENAME, GV.NCELLS and the requested grid fields
+RETURN: gp.map and gp.view[]
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: grid_map_binary
+FUNCTION: Maps the binary data file, checks its size, its header and the positions
+of the first column, and points the views of the requested fields at the records
+of ncols columns starting at col0.
+Only the pages of those columns are read by the sweep.
+INPUT: first column, number of columns (0 and NCELLS^2 for the whole grid)
+RETURN: 0, 1 if the file can not be mapped or does not match NCELLS
+*************************************************************************************/
+int grid_map_binary(long int col0, long int ncols)
+{
+  int fd, f, k, nbadpos;
+  struct stat st;
+  size_t expected, first;
+  double header[5], pos[3];
+  char *record;
+
+  fd = open(GV.FILENAME, O_RDONLY);
+  if( fd < 0 )
+    {
+      printf("  * The file '%s' doesn't exist!\n", GV.FILENAME);
+      return 1;
+    }//if
+
+  fstat(fd, &st);
+  expected = BINARY_HEADER_SIZE + (size_t) GV.NTOTALCELLS*BINARY_RECORD_SIZE;
+  if( (size_t) st.st_size != expected )
+    {
+      printf("  * The file '%s' has %ld bytes, %zu expected for N=%d\n",
+	     GV.FILENAME, (long int) st.st_size, expected, GV.NCELLS);
+      close(fd);
+      return 1;
+    }//if
+
+  gp.map = (char *) mmap(NULL, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if( gp.map == MAP_FAILED )
+    {
+      printf("  * The file '%s' could not be mapped\n", GV.FILENAME);
+      gp.map = NULL;
+      return 1;
+    }//if
+  gp.mapbytes = expected;
+
+  /*+++ The sweep goes through the columns in file order +++*/
+  madvise(gp.map, gp.mapbytes, MADV_SEQUENTIAL);
+
+  /*+++ Header: BoxSize, Omega_M0, Omega_L0, z_RS, H0, a finite box and redshift +++*/
+  memcpy(header, gp.map, BINARY_HEADER_SIZE);
+  if( !(header[0] > 0.0) || !isfinite(header[0]) || !isfinite(header[1]) || !isfinite(header[2]) ||
+      !(header[3] > -1.0) || !isfinite(header[3]) || !isfinite(header[4]) )
+    {
+      printf("  * The header of '%s' is not valid (BoxSize=%lf)\n", GV.FILENAME, header[0]);
+      grid_free();
+      return 1;
+    }//if
+
+  /*+++ Views of the requested fields, from the first record of column col0 +++*/
+  first = BINARY_HEADER_SIZE + (size_t) col0*GV.NCELLS*BINARY_RECORD_SIZE;
+  for(f=0; f<GRID_NFIELDS; f++)
+    {
+      gp.field[f] = NULL;
+      gp.view[f].base = NULL;
+      gp.view[f].stride = BINARY_RECORD_SIZE;
+      gp.view[f].single = 0;
+
+      if( !gp.requested[f] )
+	continue;
+
+      if( f == GRID_POTDOT_L_APP1 )
+	gp.view[f].base = gp.map + first + BINARY_OFFSET_L_APP1;
+      else if( f == GRID_POTDOT_L_APP2 )
+	gp.view[f].base = gp.map + first + BINARY_OFFSET_L_APP2;
+      else
+	{
+	  printf("  * The field %s is not in the binary files\n", grid_field_name(f));
+	  grid_free();
+	  return 1;
+	}//else
+    }//for f
+  gp.col0 = col0;
+  gp.ncols = ncols;
+  gp.bytes = 0;
+  if( GV.STORAGE == STORAGE_FLOAT )
+    printf("  * The mapped file is read in place as doubles, STORAGE = float is not used\n");
+
+  /*+++ Pages of the columns held, the sweep reads only those it touches +++*/
+  report_bytes_mapped(ncols*GV.NCELLS*BINARY_RECORD_SIZE);
+
+  /*+++ Positions of the first column, without touching the rest of the file +++*/
+  nbadpos = 0;
+  for(k=0; k<GV.NCELLS; k++)
+    {
+      record = gp.map + first + (size_t) k*BINARY_RECORD_SIZE;
+      memcpy(pos, record + sizeof(int), 3*sizeof(double));
+      nbadpos += grid_check_position(col0*GV.NCELLS + k, pos);
+    }//for k
+
+  if( nbadpos > 0 )
+    printf("  * %d cells are not at the centre (i+0.5)*CellSize assumed for the positions\n", nbadpos);
+
+  return 0;
+}//grid_map_binary
@@ -0,0 +1,241 @@
+/******************************************************************************
+NAME: mpi_decomposition
+FUNCTION: Distributed runs with MPI (built with -DUSE_MPI, make mpi). The
+(i,j) plane is split in GV.NPROCS contiguous ranges of columns, about
+NCELLS^2/NPROCS each. Every process holds in the grid only the cells of
+its columns, read at their place in the data file, and integrates them
+with its OpenMP threads, so both the memory and the work are divided
+among the processes. The maps are written by all the processes to the
+same files as a run with one process: at once and in place in binary,
+one process after the other in ASCII. The check and adaptive summaries
+are reduced over the processes, and only process 0 prints.
+Without USE_MPI there is one process holding all the columns.
+INPUT: GV.NCELLS, registered fields
+RETURN: Columns of each process, output files
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: mpi_start
+FUNCTION: Starts MPI and finds the process and the number of processes. The
+standard output of all the processes but process 0 is discarded.
+INPUT: arguments of main
+RETURN: 0
+*************************************************************************************/
+int mpi_start(int *argc, char ***argv)
+{
+#ifdef USE_MPI
+  int provided;
+#endif
+
+  GV.RANK = 0;
+  GV.NPROCS = 1;
+
+#ifdef USE_MPI
+  /*+++ MPI is only called outside the OpenMP regions +++*/
+  MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+  MPI_Comm_rank(MPI_COMM_WORLD, &GV.RANK);
+  MPI_Comm_size(MPI_COMM_WORLD, &GV.NPROCS);
+
+  if( GV.RANK != 0 && freopen("/dev/null", "w", stdout) == NULL )
+    fprintf(stderr, "  * Process %d could not discard its output\n", GV.RANK);
+#endif
+
+  return 0;
+}//mpi_start
+
+
+
+/*************************************************************************************
+NAME: mpi_read_parameters
+FUNCTION: Reads the parameters file in process 0 and sends the parameters to the
+other processes, so the file is read and the data file detected only once
+INPUT: Parameters file
+RETURN: 0, 1 if the parameters could not be read
+*************************************************************************************/
+int mpi_read_parameters(char *filename)
+{
+  int status=0;
+#ifdef USE_MPI
+  int rank, nprocs;
+#endif
+
+  if( GV.RANK == 0 )
+    status = read_parameters(filename);
+
+#ifdef USE_MPI
+  /*+++ GV has no pointers, it is sent as it is +++*/
+  rank = GV.RANK;
+  nprocs = GV.NPROCS;
+  MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&GV, sizeof(GV), MPI_BYTE, 0, MPI_COMM_WORLD);
+  GV.RANK = rank;
+  GV.NPROCS = nprocs;
+#endif
+
+  return status;
+}//mpi_read_parameters
+
+
+
+/*************************************************************************************
+NAME: mpi_stop
+FUNCTION: Finishes MPI
+INPUT: None
+RETURN: None
+*************************************************************************************/
+void mpi_stop(void)
+{
+#ifdef USE_MPI
+  MPI_Finalize();
+#endif
+}//mpi_stop
+
+
+
+/*************************************************************************************
+NAME: mpi_whole_grid
+FUNCTION: Leaves the run to process 0 for the sweeps whose rays cross the whole
+box, the other processes have nothing to do
+INPUT: None
+RETURN: 0, 1 in the processes that must stop
+*************************************************************************************/
+int mpi_whole_grid(void)
+{
+  if( GV.NPROCS == 1 )
+    return 0;
+
+  printf("  * Rays cross the whole box, the run is done by one of the %d processes\n", GV.NPROCS);
+  if( GV.RANK != 0 )
+    return 1;
+
+  GV.NPROCS = 1;
+
+  return 0;
+}//mpi_whole_grid
+
+
+
+/*************************************************************************************
+NAME: mpi_columns
+FUNCTION: Range of columns of this process, c = i*NCELLS + j
+INPUT: first column, number of columns
+RETURN: 0
+*************************************************************************************/
+int mpi_columns(long int *col0, long int *ncols)
+{
+  long int ncolumns;
+
+  ncolumns = (long int) GV.NCELLS*GV.NCELLS;
+  *col0 = ncolumns*GV.RANK/GV.NPROCS;
+  *ncols = ncolumns*(GV.RANK + 1)/GV.NPROCS - *col0;
+
+  if( GV.NPROCS > 1 )
+    printf("Process %d of %d holds the columns %ld to %ld\n", GV.RANK, GV.NPROCS, *col0, *col0 + *ncols - 1);
+
+  return 0;
+}//mpi_columns
+
+
+
+/*************************************************************************************
+NAME: mpi_reduce_stats
+FUNCTION: Reduces the largest check and storage differences and estimated errors, and the
+number of failed columns, of every registered field over all the processes
+INPUT: None
+RETURN: 0
+*************************************************************************************/
+int mpi_reduce_stats(void)
+{
+#ifdef USE_MPI
+  int f;
+
+  if( GV.NPROCS == 1 )
+    return 0;
+
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      MPI_Allreduce(MPI_IN_PLACE, &SWF[f].CheckMaxDiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &SWF[f].StorageMaxDiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &SWF[f].MaxError, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &SWF[f].NFailed, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    }//for f
+#endif
+
+  return 0;
+}//mpi_reduce_stats
+
+
+
+/*************************************************************************************
+NAME: mpi_output_maps
+FUNCTION: Writes the maps of the columns held by every process. In binary process 0
+writes the headers and then all the processes write their columns in place; in
+ASCII the processes append their rows in order.
+INPUT: None
+RETURN: 0, 1 if a file can not be written by a process
+*************************************************************************************/
+int mpi_output_maps(void)
+{
+  int status;
+  FILE *pf[SW_OUTPUT_FILES];
+#ifdef USE_MPI
+  int r;
+#endif
+
+  if( GV.NPROCS == 1 )
+    {
+      if( sw_output_open(pf) != 0 )
+	return 1;
+      sw_output_rows(pf);
+      sw_output_close(pf);
+
+      return 0;
+    }//if
+
+  status = 0;
+
+#ifdef USE_MPI
+  if( GV.OUTPUT_FORMAT == OUTPUT_BINARY )
+    {
+      /*+++ Headers +++*/
+      if( GV.RANK == 0 )
+	{
+	  status = sw_output_open(pf);
+	  if( status == 0 )
+	    sw_output_close(pf);
+	}//if
+      MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+      if( status != 0 )
+	return 1;
+
+      /*+++ Columns, each process at its offsets +++*/
+      status = sw_output_reopen(pf);
+      if( status == 0 )
+	{
+	  sw_output_rows(pf);
+	  sw_output_close(pf);
+	}//if
+      MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+      return status;
+    }//if
+
+  /*+++ ASCII rows, process after process +++*/
+  for(r=0; r<GV.NPROCS; r++)
+    {
+      if( GV.RANK == r && status == 0 )
+	{
+	  status = r == 0 ? sw_output_open(pf) : sw_output_reopen(pf);
+	  if( status == 0 )
+	    {
+	      sw_output_rows(pf);
+	      sw_output_close(pf);
+	    }//if
+	}//if
+      MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    }//for r
+#endif
+
+  return status;
+}//mpi_output_maps
@@ -0,0 +1,370 @@
+/******************************************************************************
+NAME: output_writer
+FUNCTION: Writes the SW maps of the registered fields, and their 3D dT/dr
+when DT_DR is set. In ASCII (default) every field has its own file, with
+one formatted row per column (per cell for dT/dr), with the estimated
+error as a last column in INTEG_ADAPTIVE mode. In binary all the maps
+go to BINARY_OUTPUT_FILE and the dT/dr of each field to its own file: a
+small self-describing header followed by dense float64 arrays,
+map[i*NCELLS + j] or dT_dr[INDEX_C_ORDER(i,j,k)], written through a large
+stdio buffer. The header is, in order:
+  char magic[8]      "SWMAPS01" for the maps, "SWDTDR01" for dT/dr
+  int  NCELLS, nfields
+  double BoxSize, Omega_M0, Omega_L0, z_RS, H0, a_SF
+  char names[nfields][SW_NAME_LEN]
+In INTEG_ADAPTIVE mode the maps of the errors, named <field>_err, follow
+the maps of the values in BINARY_OUTPUT_FILE.
+The files are kept in pf[f] for the maps (pf[0] in binary) and in
+pf[MAX_SW_FIELDS + f] for dT/dr.
+INPUT: Maps of the columns held by the grid, GV.OUTPUT_FORMAT, GV.DT_DR_OUTPUT
+RETURN: Output files
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: binary_output_header_size
+FUNCTION: Size of the header of a binary output file
+INPUT: number of fields in the file
+RETURN: bytes
+*************************************************************************************/
+long int binary_output_header_size(int nfields)
+{
+  return 8 + 2*sizeof(int) + 6*sizeof(double) + (long int) nfields*SW_NAME_LEN;
+}//binary_output_header_size
+
+
+
+/*************************************************************************************
+NAME: write_binary_header
+FUNCTION: Writes the header of a binary output file with the names of nfields
+registered fields starting at f0, followed by the names of their error maps
+INPUT: output file, magic, first field, number of fields, 1 if the file has
+error maps
+RETURN: 0
+*************************************************************************************/
+int write_binary_header(FILE *pf, char *magic, int f0, int nfields, int errors)
+{
+  int f, nmaps;
+  double params[6];
+  char name[SW_NAME_LEN];
+
+  params[0] = GV.BoxSize;
+  params[1] = GV.Omega_M0;
+  params[2] = GV.Omega_L0;
+  params[3] = GV.z_RS;
+  params[4] = GV.H0;
+  params[5] = GV.a_SF;
+
+  fwrite(magic, 1, 8, pf);
+  fwrite(&GV.NCELLS, sizeof(int), 1, pf);
+  nmaps = errors ? 2*nfields : nfields;
+  fwrite(&nmaps, sizeof(int), 1, pf);
+  fwrite(params, sizeof(double), 6, pf);
+  for(f=f0; f<f0+nfields; f++)
+    {
+      memset(name, 0, SW_NAME_LEN);
+      strncpy(name, SWF[f].name, SW_NAME_LEN-1);
+      fwrite(name, 1, SW_NAME_LEN, pf);
+    }//for f
+
+  if( errors )
+    for(f=f0; f<f0+nfields; f++)
+      {
+	memset(name, 0, SW_NAME_LEN);
+	snprintf(name, SW_NAME_LEN, "%.*s_err", SW_NAME_LEN-5, SWF[f].name);
+	fwrite(name, 1, SW_NAME_LEN, pf);
+      }//for f
+
+  return 0;
+}//write_binary_header
+
+
+
+/*************************************************************************************
+NAME: sw_output_path
+FUNCTION: Path of an output file. A name starting with ./ goes to
+GV.OUTPUT_PREFIX instead when it is set.
+INPUT: file name, path and its size
+RETURN: path
+*************************************************************************************/
+char *sw_output_path(char *filename, char *path, size_t size)
+{
+  if( GV.OUTPUT_PREFIX[0] != '\0' && strncmp(filename, "./", 2) == 0 )
+    snprintf(path, size, "%s%s", GV.OUTPUT_PREFIX, filename + 2);
+  else
+    snprintf(path, size, "%s", filename);
+
+  return path;
+}//sw_output_path
+
+
+
+/*************************************************************************************
+NAME: sw_output_file
+FUNCTION: Opens one output file at its sw_output_path, reporting if it can not
+be written
+INPUT: file name, fopen mode, buffer size (0 for the default)
+RETURN: file, NULL if it can not be opened
+*************************************************************************************/
+FILE *sw_output_file(char *filename, char *mode, size_t buffer)
+{
+  FILE *pf=NULL;
+  char path[2100];
+
+  pf = fopen(sw_output_path(filename, path, sizeof(path)), mode);
+  if( pf == NULL )
+    {
+      printf("  * The file '%s' can not be written!\n", path);
+      return NULL;
+    }//if
+
+  if( buffer > 0 )
+    setvbuf(pf, NULL, _IOFBF, buffer);
+
+  return pf;
+}//sw_output_file
+
+
+
+/*************************************************************************************
+NAME: sw_output_files
+FUNCTION: Opens the output files, new with their headers, or already written by
+another process to add the rows of the columns held by the grid: at the end in
+ASCII, in place in binary
+INPUT: array of SW_OUTPUT_FILES files, 1 to reopen the files
+RETURN: 0, 1 if a file can not be opened
+*************************************************************************************/
+int sw_output_files(FILE **pf, int reopen)
+{
+  int f;
+  char filename[1100], *mode;
+
+  /*+++ Maps +++*/
+  if( GV.OUTPUT_FORMAT == OUTPUT_ASCII )
+    {
+      mode = reopen ? "a" : "w";
+      for(f=0; f<NSWFIELDS; f++)
+	{
+	  pf[f] = sw_output_file(SWF[f].outfile, mode, 0);
+	  if( pf[f] == NULL )
+	    return 1;
+	  if( reopen )
+	    continue;
+	  if( SWF[f].SW_err != NULL )
+	    fprintf(pf[f], "%s\t SW_Error\n", SWF[f].header);
+	  else
+	    fprintf(pf[f], "%s\n", SWF[f].header);
+	}//for f
+    }//if
+  else
+    {
+      mode = reopen ? "r+" : "w";
+      pf[0] = sw_output_file(BINARY_OUTPUT_FILE, mode, BINARY_OUTPUT_BUFFER);
+      if( pf[0] == NULL )
+	return 1;
+      if( !reopen )
+	write_binary_header(pf[0], "SWMAPS01", 0, NSWFIELDS, GV.INTEG_MODE == INTEG_ADAPTIVE);
+    }//else
+
+  /*+++ dT/dr +++*/
+  if( !GV.DT_DR_OUTPUT )
+    return 0;
+
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      if( GV.OUTPUT_FORMAT == OUTPUT_ASCII )
+	{
+	  snprintf(filename, sizeof(filename), "./dT_dr_%.*s.dat", SW_NAME_LEN, SWF[f].name);
+	  pf[MAX_SW_FIELDS+f] = sw_output_file(filename, mode, BINARY_OUTPUT_BUFFER);
+	  if( pf[MAX_SW_FIELDS+f] == NULL )
+	    return 1;
+	  if( !reopen )
+	    fprintf(pf[MAX_SW_FIELDS+f], "#n\t i\t j\t k\t x\t y\t z\t dT_dr\n");
+	}//if
+      else
+	{
+	  snprintf(filename, sizeof(filename), "./dT_dr_%.*s.bin", SW_NAME_LEN, SWF[f].name);
+	  pf[MAX_SW_FIELDS+f] = sw_output_file(filename, mode, BINARY_OUTPUT_BUFFER);
+	  if( pf[MAX_SW_FIELDS+f] == NULL )
+	    return 1;
+	  if( !reopen )
+	    write_binary_header(pf[MAX_SW_FIELDS+f], "SWDTDR01", f, 1, 0);
+	}//else
+    }//for f
+
+  return 0;
+}//sw_output_files
+
+
+
+/*************************************************************************************
+NAME: sw_output_open
+FUNCTION: Opens the output files and writes their headers
+INPUT: array of SW_OUTPUT_FILES files
+RETURN: 0, 1 if a file can not be opened
+*************************************************************************************/
+int sw_output_open(FILE **pf)
+{
+  return sw_output_files(pf, 0);
+}//sw_output_open
+
+
+
+/*************************************************************************************
+NAME: sw_output_reopen
+FUNCTION: Opens the output files written by another process, to add rows
+INPUT: array of SW_OUTPUT_FILES files
+RETURN: 0, 1 if a file can not be opened
+*************************************************************************************/
+int sw_output_reopen(FILE **pf)
+{
+  return sw_output_files(pf, 1);
+}//sw_output_reopen
+
+
+
+/*************************************************************************************
+NAME: write_dT_dr_rows
+FUNCTION: Writes the ASCII rows of the cells of the columns held by the grid for
+the dT/dr of one field
+INPUT: output file, index of the field in SWF[]
+RETURN: 0
+*************************************************************************************/
+int write_dT_dr_rows(FILE *pf, int f)
+{
+  int i, j, k;
+  long int c;
+
+  for(c=gp.col0; c<gp.col0+gp.ncols; c++)
+    {
+      i = c / GV.NCELLS;
+      j = c % GV.NCELLS;
+
+      for(k=0; k<GV.NCELLS; k++)
+	fprintf(pf, "%12ld %12d %12d %12d %16.8f %16.8f %16.8f %16.8e\n",
+		INDEX_C_ORDER(i,j,k), i, j, k,
+		GRID_POS(i), GRID_POS(j), GRID_POS(k),
+		SWF[f].dT_dr[(c - gp.col0)*GV.NCELLS + k]);
+    }//for c
+
+  return 0;
+}//write_dT_dr_rows
+
+
+
+/*************************************************************************************
+NAME: write_SW_rows
+FUNCTION: Writes the ASCII rows of the columns held by the grid for one field
+INPUT: output file, index of the field in SWF[]
+RETURN: 0
+*************************************************************************************/
+int write_SW_rows(FILE *pf, int f)
+{
+  int i, j;
+  long int c, n;
+
+  for(c=gp.col0; c<gp.col0+gp.ncols; c++)
+    {
+      i = c / GV.NCELLS;
+      j = c % GV.NCELLS;
+      n = INDEX_C_2D(i,j);
+
+      if( SWF[f].SW_err != NULL )
+	fprintf(pf, SWF[f].errformat,
+		(int) n, i, j,
+		GRID_POS(i), GRID_POS(j), SWF[f].SW_map[c - gp.col0], SWF[f].SW_err[c - gp.col0]);
+      else
+	fprintf(pf, SWF[f].rowformat,
+		(int) n, i, j,
+		GRID_POS(i), GRID_POS(j), SWF[f].SW_map[c - gp.col0]);
+    }//for c
+
+  return 0;
+}//write_SW_rows
+
+
+
+/*************************************************************************************
+NAME: sw_output_rows
+FUNCTION: Writes the columns held by the grid for all the fields. In binary each
+field (and its errors and dT/dr) is one fwrite at the place of its first
+column, so slabs can come in any order.
+INPUT: files opened by sw_output_open
+RETURN: 0
+*************************************************************************************/
+int sw_output_rows(FILE **pf)
+{
+  int f, nmaps;
+  long int offset, ncolumns;
+
+  ncolumns = (long int) GV.NCELLS*GV.NCELLS;
+  nmaps = GV.INTEG_MODE == INTEG_ADAPTIVE ? 2*NSWFIELDS : NSWFIELDS;
+
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      if( GV.OUTPUT_FORMAT == OUTPUT_ASCII )
+	{
+	  offset = ftell(pf[f]);
+	  write_SW_rows(pf[f], f);
+	  report_bytes_written(ftell(pf[f]) - offset);
+	  if( GV.DT_DR_OUTPUT )
+	    {
+	      offset = ftell(pf[MAX_SW_FIELDS+f]);
+	      write_dT_dr_rows(pf[MAX_SW_FIELDS+f], f);
+	      report_bytes_written(ftell(pf[MAX_SW_FIELDS+f]) - offset);
+	    }//if
+	  continue;
+	}//if
+
+      offset = binary_output_header_size(nmaps) + (f*ncolumns + gp.col0)*(long int) sizeof(double);
+      if( ftell(pf[0]) != offset )
+	fseek(pf[0], offset, SEEK_SET);
+      fwrite(SWF[f].SW_map, sizeof(double), (size_t) gp.ncols, pf[0]);
+      report_bytes_written(gp.ncols*(long int) sizeof(double));
+
+      if( SWF[f].SW_err != NULL )
+	{
+	  offset = binary_output_header_size(nmaps) + ((NSWFIELDS + f)*ncolumns + gp.col0)*(long int) sizeof(double);
+	  if( ftell(pf[0]) != offset )
+	    fseek(pf[0], offset, SEEK_SET);
+	  fwrite(SWF[f].SW_err, sizeof(double), (size_t) gp.ncols, pf[0]);
+	  report_bytes_written(gp.ncols*(long int) sizeof(double));
+	}//if
+
+      if( GV.DT_DR_OUTPUT )
+	{
+	  offset = binary_output_header_size(1) + gp.col0*GV.NCELLS*(long int) sizeof(double);
+	  if( ftell(pf[MAX_SW_FIELDS+f]) != offset )
+	    fseek(pf[MAX_SW_FIELDS+f], offset, SEEK_SET);
+	  fwrite(SWF[f].dT_dr, sizeof(double), (size_t) gp.ncols*GV.NCELLS, pf[MAX_SW_FIELDS+f]);
+	  report_bytes_written(gp.ncols*GV.NCELLS*(long int) sizeof(double));
+	}//if
+    }//for f
+
+  return 0;
+}//sw_output_rows
+
+
+
+/*************************************************************************************
+NAME: sw_output_close
+FUNCTION: Closes the output files
+INPUT: files opened by sw_output_open
+RETURN: none
+*************************************************************************************/
+void sw_output_close(FILE **pf)
+{
+  int f;
+
+  if( GV.OUTPUT_FORMAT == OUTPUT_ASCII )
+    {
+      for(f=0; f<NSWFIELDS; f++)
+	fclose(pf[f]);
+    }//if
+  else
+    fclose(pf[0]);
+
+  if( GV.DT_DR_OUTPUT )
+    for(f=0; f<NSWFIELDS; f++)
+      fclose(pf[MAX_SW_FIELDS+f]);
+}//sw_output_close
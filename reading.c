@@ -1,32 +1,357 @@
 /****************************************************************************************************
-NAME: conf2dump
-FUNCTION: Reads the input file with parameters
-INPUT: Parameters file
+NAME: default_run_options
+FUNCTION: Sets the run options to their default values
+INPUT: None
 RETURN: 0
 ****************************************************************************************************/
+int default_run_options( void )
+{
+  GV.INPUT_FORMAT = INPUT_AUTO;
+  GV.INTEG_MODE = INTEG_SIMPSON;
+  GV.IntegCheckMaxDiff = 0.0;
+  GV.BINARY_READER = READER_FREAD;
+  GV.SWEEP_MODE = SWEEP_GRID;
+  GV.STREAM_COLUMNS = 0;
+  GV.STREAM_PREFETCH = 2;
+  GV.OUTPUT_FORMAT = OUTPUT_ASCII;
+  GV.OUTPUT_PREFIX[0] = '\0';
+  GV.DT_DR_OUTPUT = 0;
+  GV.CHECKPOINT = 0.0;
+  GV.RESTART = 0;
+  GV.SIMD_MODE = SIMD_AUTO;
+  GV.EPSABS = 0.0;
+  GV.EPSREL = 1e-6;
+  GV.INTERP_KIND = INTERP_LINEAR;
+  GV.STORAGE = STORAGE_DOUBLE;
+  GV.LOS[X] = 0.0;
+  GV.LOS[Y] = 0.0;
+  GV.LOS[Z] = 1.0;
+  GV.SKY_NSIDE = 0;
+  GV.OBSERVER[X] = GV.OBSERVER[Y] = GV.OBSERVER[Z] = 0.0;
+  GV.RMAX = 0.0;
+
+  return 0;
+}//default_run_options
+
+
 
-int conf2dump( char filename[] )
+/****************************************************************************************************
+NAME: parameter_trim
+FUNCTION: Removes the blanks at both ends of a string, in place
+INPUT: string
+RETURN: first character that is not blank
+****************************************************************************************************/
+char *parameter_trim( char *s )
 {
-  int nread;
-  char cmd[1000];
-  sprintf( cmd, "grep -v \"#\" %s | grep -v \"^$\" | gawk -F\"=\" '{print $2}' > %s.dump", 
-	   filename, filename );
-  nread = system( cmd );
-  
+  char *end;
+
+  while( isspace((unsigned char) *s) )
+    s++;
+
+  end = s + strlen(s);
+  while( end > s && isspace((unsigned char) end[-1]) )
+    end--;
+  *end = '\0';
+
+  return s;
+}//parameter_trim
+
+
+
+/****************************************************************************************************
+NAME: parameter_choice
+FUNCTION: Reads an option given by name. The names are in the order of the values
+of their defines, so the index of the name is the value of the option.
+INPUT: key, value, names of the choices, number of choices, option
+RETURN: 0, 1 if the value is not one of the names (the option is not changed)
+****************************************************************************************************/
+int parameter_choice( char *key, char *value, char **names, int nnames, int *option )
+{
+  int n;
+
+  for(n=0; n<nnames; n++)
+    if( strcmp(value, names[n]) == 0 )
+      {
+	*option = n;
+	return 0;
+      }//if
+
+  printf( "  * Unknown %s '%s', using %s\n", key, value, names[*option] );
+
+  return 1;
+}//parameter_choice
+
+
+
+/****************************************************************************************************
+NAME: parameter_numbers
+FUNCTION: Reads n numbers separated by blanks
+INPUT: key, value, number of values, array of n doubles
+RETURN: 0, 1 if the value does not hold n numbers (the array is not changed)
+****************************************************************************************************/
+int parameter_numbers( char *key, char *value, int n, double *x )
+{
+  int i;
+  double y[3];
+  char *p, *end;
+
+  p = value;
+  for(i=0; i<n; i++)
+    {
+      y[i] = strtod(p, &end);
+      if( end == p )
+	{
+	  printf( "  * %s needs %d numbers, '%s' ignored\n", key, n, value );
+	  return 1;
+	}//if
+      p = end;
+    }//for i
+
+  for(i=0; i<n; i++)
+    x[i] = y[i];
+
   return 0;
-}
+}//parameter_numbers
+
+
+
+/****************************************************************************************************
+NAME: set_parameter
+FUNCTION: Sets the parameter of one line 'KEY = value' of the parameters file
+INPUT: key, value
+RETURN: 0, 1 if the key is unknown
+****************************************************************************************************/
+int set_parameter( char *key, char *value )
+{
+  static char *formats[] = {"ascii", "binary", "auto"};
+  static char *integrations[] = {"simpson", "exact", "check", "adaptive"};
+  static char *readers[] = {"fread", "mmap"};
+  static char *sweeps[] = {"grid", "stream"};
+  static char *outputs[] = {"ascii", "binary"};
+  static char *simds[] = {"auto", "scalar", "avx2", "avx512"};
+  static char *interps[] = {"linear", "cspline", "akima", "steffen"};
+  static char *storages[] = {"double", "float", "check"};
+
+  /*+++++ Data +++++*/
+  if( strcmp(key, "N") == 0 )
+    GV.NCELLS = atoi(value);
+  else if( strcmp(key, "FILENAME") == 0 )
+    snprintf(GV.FILENAME, sizeof(GV.FILENAME), "%s", value);
+  else if( strcmp(key, "FORMAT") == 0 )
+    parameter_choice(key, value, formats, 3, &GV.INPUT_FORMAT);
+
+  /*+++++ Simulation and cosmological parameters of the ASCII data +++++*/
+  else if( strcmp(key, "L") == 0 )
+    parameter_numbers(key, value, 1, &GV.BoxSize);
+  else if( strcmp(key, "OmegaM0") == 0 )
+    parameter_numbers(key, value, 1, &GV.Omega_M0);
+  else if( strcmp(key, "OmegaL0") == 0 )
+    parameter_numbers(key, value, 1, &GV.Omega_L0);
+  else if( strcmp(key, "z") == 0 )
+    parameter_numbers(key, value, 1, &GV.z_RS);
+  else if( strcmp(key, "H") == 0 )
+    parameter_numbers(key, value, 1, &GV.H0);
+
+  /*+++++ Run options +++++*/
+  else if( strcmp(key, "INTEGRATION") == 0 )
+    parameter_choice(key, value, integrations, 4, &GV.INTEG_MODE);
+  else if( strcmp(key, "BINARY_READER") == 0 )
+    parameter_choice(key, value, readers, 2, &GV.BINARY_READER);
+  else if( strcmp(key, "SWEEP") == 0 )
+    parameter_choice(key, value, sweeps, 2, &GV.SWEEP_MODE);
+  else if( strcmp(key, "STREAM_COLUMNS") == 0 )
+    GV.STREAM_COLUMNS = atol(value);
+  else if( strcmp(key, "STREAM_PREFETCH") == 0 )
+    GV.STREAM_PREFETCH = atoi(value);
+  else if( strcmp(key, "OUTPUT") == 0 )
+    parameter_choice(key, value, outputs, 2, &GV.OUTPUT_FORMAT);
+  else if( strcmp(key, "OUTPUT_PREFIX") == 0 )
+    snprintf(GV.OUTPUT_PREFIX, sizeof(GV.OUTPUT_PREFIX), "%s", value);
+  else if( strcmp(key, "DT_DR") == 0 )
+    GV.DT_DR_OUTPUT = atoi(value);
+  else if( strcmp(key, "CHECKPOINT") == 0 )
+    parameter_numbers(key, value, 1, &GV.CHECKPOINT);
+  else if( strcmp(key, "RESTART") == 0 )
+    GV.RESTART = atoi(value);
+  else if( strcmp(key, "SIMD") == 0 )
+    parameter_choice(key, value, simds, 4, &GV.SIMD_MODE);
+  else if( strcmp(key, "EPSABS") == 0 )
+    parameter_numbers(key, value, 1, &GV.EPSABS);
+  else if( strcmp(key, "EPSREL") == 0 )
+    parameter_numbers(key, value, 1, &GV.EPSREL);
+  else if( strcmp(key, "INTERP") == 0 )
+    parameter_choice(key, value, interps, 4, &GV.INTERP_KIND);
+  else if( strcmp(key, "STORAGE") == 0 )
+    parameter_choice(key, value, storages, 3, &GV.STORAGE);
+  else if( strcmp(key, "LOS") == 0 )
+    parameter_numbers(key, value, 3, GV.LOS);
+  else if( strcmp(key, "SKY_NSIDE") == 0 )
+    GV.SKY_NSIDE = atol(value);
+  else if( strcmp(key, "OBSERVER") == 0 )
+    parameter_numbers(key, value, 3, GV.OBSERVER);
+  else if( strcmp(key, "RMAX") == 0 )
+    parameter_numbers(key, value, 1, &GV.RMAX);
+  else
+    return 1;
+
+  return 0;
+}//set_parameter
+
+
+
+/****************************************************************************************************
+NAME: detect_input_format
+FUNCTION: Finds the format of the data file from its first bytes, decompressed if
+the file is compressed. A binary file has the size of its header and N^3
+records (unless compressed) and starts with a positive BoxSize; an ASCII file
+starts with a line of text.
+INPUT: GV.FILENAME, GV.NCELLS
+RETURN: INPUT_ASCII, INPUT_BINARY, or -1 if the file can not be read or recognised
+****************************************************************************************************/
+int detect_input_format( void )
+{
+  int ascii, compression;
+  long int ncells;
+  size_t i, nbytes, size;
+  struct stat st;
+  double header[5];
+  unsigned char text[256];
+  FILE *pf=NULL;
+
+  compression = input_compression(GV.FILENAME);
+  pf = input_open(GV.FILENAME);
+  if( pf == NULL )
+    {
+      printf( "  * The file '%s' doesn't exist!\n", GV.FILENAME );
+      return -1;
+    }//if
+  stat(GV.FILENAME, &st);
+  size = compression == COMPRESS_NONE ? (size_t) st.st_size : 0;
+
+  nbytes = fread(text, 1, sizeof(text), pf);
+  fclose(pf);
+  if( nbytes == 0 )
+    {
+      printf( "  * The file '%s' is empty!\n", GV.FILENAME );
+      return -1;
+    }//if
+
+  /*+++ ASCII: printable characters up to the end of the first line +++*/
+  ascii = 1;
+  for(i=0; i<nbytes && text[i] != '\n'; i++)
+    if( !isprint(text[i]) && !isspace(text[i]) )
+      ascii = 0;
+
+  /*+++ Binary: header and one record per cell, the size is only known uncompressed +++*/
+  ncells = (long int) GV.NCELLS*GV.NCELLS*GV.NCELLS;
+  if( nbytes >= BINARY_HEADER_SIZE &&
+      (compression == COMPRESS_NONE ? size == BINARY_HEADER_SIZE + (size_t) ncells*BINARY_RECORD_SIZE : !ascii) )
+    {
+      memcpy(header, text, BINARY_HEADER_SIZE);
+      if( isfinite(header[0]) && header[0] > 0.0 )
+	return INPUT_BINARY;
+    }//if
+
+  if( !ascii )
+    {
+      printf( "  * The format of '%s' is not recognised, set FORMAT\n", GV.FILENAME );
+      return -1;
+    }//if
+
+  return INPUT_ASCII;
+}//detect_input_format
+
+
+
+/****************************************************************************************************
+NAME: check_parameters
+FUNCTION: Checks that the data is defined, detects the format of the data file
+with FORMAT = auto, reads compressed files with fread instead of mmap and sets
+the scale factor
+INPUT: None
+RETURN: 0, 1 if the data is not defined or its format not recognised
+****************************************************************************************************/
+int check_parameters( void )
+{
+  int compression;
+
+  if( GV.NCELLS <= 0 || GV.FILENAME[0] == '\0' )
+    {
+      printf( "  * N and FILENAME must be given\n" );
+      return 1;
+    }//if
+
+  /*+++++ Compressed data files are decompressed while they are read +++++*/
+  compression = input_compression(GV.FILENAME);
+  if( compression != COMPRESS_NONE )
+    {
+      printf( "Data file compressed with %s\n", compression == COMPRESS_GZIP ? "gzip" : "zstd" );
+#ifndef HAVE_ZSTD
+      if( compression == COMPRESS_ZSTD )
+	{
+	  printf( "  * Build with HAVE_ZSTD (make zstd) to read zstd data files\n" );
+	  return 1;
+	}//if
+#endif
+      if( GV.BINARY_READER == READER_MMAP )
+	{
+	  printf( "  * A compressed file can not be mapped, it is read with fread\n" );
+	  GV.BINARY_READER = READER_FREAD;
+	}//if
+    }//if
+
+  /*+++++ Format of the data file +++++*/
+  if( GV.INPUT_FORMAT == INPUT_AUTO )
+    {
+      GV.INPUT_FORMAT = detect_input_format();
+      if( GV.INPUT_FORMAT < 0 )
+	return 1;
+    }//if
+  if( GV.INPUT_FORMAT == INPUT_ASCII && !(GV.BoxSize > 0.0) )
+    {
+      printf( "  * L must be given for ASCII data\n" );
+      return 1;
+    }//if
+  GV.a_SF = 1.0/(1.0 + GV.z_RS);
+
+  return 0;
+}//check_parameters
+
+
+
+/****************************************************************************************************
+NAME: derived_parameters
+FUNCTION: Sets the constants derived from the parameters: number of cells, cell
+size, speed of light and CMB temperature
+INPUT: None
+RETURN: 0
+****************************************************************************************************/
+int derived_parameters( void )
+{
+  GV.ZERO         = 1e-30;
+  GV.NTOTALCELLS  = (long int) GV.NCELLS*GV.NCELLS*GV.NCELLS;
+  GV.CellSize     = GV.BoxSize/(1.0*GV.NCELLS);
+  GV.c_SL = 299792.458; // km/s
+  GV.CMB_T0 = 2725480; // micro K
+  GV.CellStep = GV.CellSize / 2.0;
+
+  return 0;
+}//derived_parameters
+
 
 
 /****************************************************************************************************
 NAME: read_parameters
-FUNCTION: Reads the parameters
+FUNCTION: Reads the parameters file, one 'KEY = value' per line. Lines starting
+with # and empty lines are skipped, options that are not given keep their
+default values. With FORMAT = auto the format of the data file is detected.
 INPUT: Parameters file
-RETURN: 0
+RETURN: 0, 1 if the file can not be read or the data is not defined
 ****************************************************************************************************/
 int read_parameters( char filename[] )
 {
-  int nread;
-  char cmd[1000], filenamedump[1000];
+  int nline;
+  char line[2000], *key, *value, *c;
   FILE *file;
   
   /*+++++ Loading the file +++++*/
@@ -36,108 +361,178 @@ int read_parameters( char filename[] )
       printf( "  * The file '%s' doesn't exist!\n", filename );
       return 1;
     }
-  fclose(file);
-  
-  /*+++++ Converting to plain text +++++*/
-  conf2dump( filename );
-  sprintf( filenamedump, "%s.dump", filename );
-  file = fopen( filenamedump, "r" );
-  
-  /*+++++ Parameters for binary data +++++*/
-#ifdef BINARYDATA
-  nread = fscanf(file, "%d", &GV.NCELLS);
-  nread = fscanf(file, "%s", GV.FILENAME);    
-#endif
 
+  GV.NCELLS = 0;
+  GV.FILENAME[0] = '\0';
+  default_run_options();
 
-  /*+++++ Parameters for ASCII data +++++*/
-#ifdef ASCIIDATA
-  /*+++++ Simulation parameters +++++*/
-  nread = fscanf(file, "%d", &GV.NCELLS);
-  nread = fscanf(file, "%lf", &GV.BoxSize);
-  nread = fscanf(file, "%s", GV.FILENAME);
-  
-  /*+++++ Cosmological parameters +++++*/  
-  nread = fscanf(file, "%lf", &GV.Omega_M0);
-  nread = fscanf(file, "%lf", &GV.Omega_L0);
-  nread = fscanf(file, "%lf", &GV.z_RS);
-  nread = fscanf(file, "%lf", &GV.H0);    
-  GV.a_SF = 1.0/(1.0 + GV.z_RS); 
-#endif
+  for(nline=1; fgets(line, sizeof(line), file) != NULL; nline++)
+    {
+      /*+++++ Comments and empty lines +++++*/
+      if( (c = strchr(line, '#')) != NULL )
+	*c = '\0';
+      key = parameter_trim(line);
+      if( *key == '\0' )
+	continue;
 
-    fclose( file );
-    
-    printf( "  * The file '%s' has been loaded!\n", filename );
+      c = strchr(key, '=');
+      if( c == NULL )
+	{
+	  printf( "  * Line %d of '%s' is not KEY = value: '%s'\n", nline, filename, key );
+	  continue;
+	}//if
+      *c = '\0';
+      key = parameter_trim(key);
+      value = parameter_trim(c + 1);
+
+      if( set_parameter(key, value) != 0 )
+	printf( "  * Unknown parameter '%s' in line %d of '%s'\n", key, nline, filename );
+    }//for nline
 
-    sprintf( cmd, "rm -rf %s.dump", filename );
-    nread = system( cmd );
+  fclose( file );
+
+  if( check_parameters() != 0 )
+    return 1;
+    
+  printf( "  * The file '%s' has been loaded!\n", filename );
     
-    return 0;
-}
+  return 0;
+}//read_parameters
+
+
+
+/**************************************************************************
+NAME: read_data_cells
+FUNCTION: reads ncells lines of the ASCII data file into the grid, starting
+at cell m0 
+INPUT: data file positioned at the line of cell m0, first cell, number of cells
+RETURN: number of cells whose position is not the expected cell centre, -1 if
+the file ends or a line can not be read before the last cell
+*****************************************************************************/
+
+long int read_data_cells(FILE *pf, long int m0, long int ncells)
+{
+  long int m, nbadpos, offset;
+  int nread, GID;
+  double dummy, pos[3], potDot[GRID_NFIELDS];
+  
+  offset = ftell(pf);
+  nbadpos = 0;
+  for(m=m0; m<m0+ncells; m++)
+    {     
+      nread=fscanf(pf,"%d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf", 
+		   &GID, 
+		   &pos[X], &pos[Y], &pos[Z], 
+		   &dummy, &dummy, &dummy, 
+		   &dummy, &dummy,
+		   &potDot[GRID_POTDOT],
+		   &potDot[GRID_POTDOT_L_APP1], &potDot[GRID_POTDOT_L_APP2]);
+      if( nread != 12 )
+	{
+	  printf("  * The line of cell %ld can not be read\n", m);
+	  report_bytes_read(ftell(pf) - offset);
+	  return -1;
+	}//if
+      
+      grid_store(GRID_POTDOT, m, potDot[GRID_POTDOT]);
+      grid_store(GRID_POTDOT_L_APP1, m, potDot[GRID_POTDOT_L_APP1]);
+      grid_store(GRID_POTDOT_L_APP2, m, potDot[GRID_POTDOT_L_APP2]);
+      
+      nbadpos += grid_check_position(m, pos);
+      
+      if(m%10000000==0)
+	{
+	  printf("\n%d %lf %lf %lf\n", 
+		 GID,
+		 pos[X], pos[Y], pos[Z]);
+	}//if 
+    }//for m
+  
+  report_bytes_read(ftell(pf) - offset);
+  
+  return nbadpos;
+}//read_data_cells
 
 
 
 /**************************************************************************
 NAME: read_data
-FUNCTION: reads the input file 
+FUNCTION: reads the cells of the columns held by the grid filled by the readers
+(gread) from the input file
 INPUT: GV.FILENAME variable
-RETURN: 0
+RETURN: 0, 1 if the file can not be opened or read
 *****************************************************************************/
 
 int read_data(char *infile)
 {
-  int m, nread;
+  int status;
+  long int m, nbadpos;
   FILE *pf=NULL;
   char buff[1000];
-  double dummy;
   
   printf("Reading the file!\n");
   
-  pf = fopen(infile, "r");
+  /*+++ Parallel parser on the mapped file, fscanf if it can not be mapped or is compressed +++*/
+  if( input_compression(infile) == COMPRESS_NONE )
+    {
+      status = read_data_parallel(infile);
+      if( status != 1 )
+	return status != 0;
+    }//if
+  
+  pf = input_open(infile);
+  if( pf == NULL )
+    {
+      printf("  * The file '%s' doesn't exist!\n", infile);
+      return 1;
+    }//if
   
   /*Ignoring the first line*/
-  nread = fgets(buff, 1000, pf);
+  if( fgets(buff, 1000, pf) == NULL )
+    printf("  * The file '%s' is empty!\n", infile);
+  
+  /*Skipping the lines of the columns before the grid*/
+  for(m=0; m<gread->col0*GV.NCELLS; m++)
+    if( fgets(buff, 1000, pf) == NULL )
+      break;
   
   /*Reading from the second line*/
-  for(m=0; m<GV.NTOTALCELLS; m++)
-    {     
-      nread=fscanf(pf,"%d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf", 
-		   &gp[m].GID, 
-		   &gp[m].pos[X], &gp[m].pos[Y], &gp[m].pos[Z], 
-		   &dummy, &dummy, &dummy, 
-		   &dummy, &dummy,
-		   &gp[m].potDot_r,
-		   &gp[m].potDot_r_l_app1, &gp[m].potDot_r_l_app2);
-      
-      if(m%10000000==0)
-	{
-	  printf("\n%d %lf %lf %lf\n", 
-		 gp[m].GID,
-		 gp[m].pos[X], gp[m].pos[Y], gp[m].pos[Z]);
-	}//if 
-    }//for m
+  nbadpos = read_data_cells(pf, gread->col0*GV.NCELLS, gread->ncols*GV.NCELLS);
   
   fclose(pf);
   
+  if( nbadpos < 0 )
+    {
+      printf("  * The file '%s' does not hold all the cells of the grid!\n", infile);
+      return 1;
+    }//if
+  
+  if( nbadpos > 0 )
+    printf("  * %ld cells are not at the centre (i+0.5)*CellSize assumed for the positions\n", nbadpos);
+  
   return 0;
 }//read_data
 
 
 
 /**************************************************************************************************** 
-NAME: read_binary
-FUNCTION: Reads the binary data file
+NAME: read_binary_header
+FUNCTION: Reads the simulation parameters at the beginning of the binary data file
 INPUT: None
-RETURN: 0 
+RETURN: 0, 1 if the file can not be opened
 ****************************************************************************************************/
 
-int read_binary(void)
+int read_binary_header(void)
 {
-  int i, nread;
-  double pos_aux[3], dummy;
+  int nread;
   FILE *inFile=NULL;
   
-  inFile = fopen(GV.FILENAME, "r");
+  inFile = input_open(GV.FILENAME);
+  if( inFile == NULL )
+    {
+      printf("  * The file '%s' doesn't exist!\n", GV.FILENAME);
+      return 1;
+    }//if
 
   printf("Reading simulation parameters\n");
   /*+++++ Saving Simulation parameters +++++*/
@@ -147,7 +542,11 @@ int read_binary(void)
   nread = fread(&GV.z_RS, sizeof(double), 1, inFile);  //Redshift
   nread = fread(&GV.H0, sizeof(double), 1, inFile);  //Hubble parameter
 
+  fclose(inFile);
+
   GV.a_SF = 1.0 / (1.0 + GV.z_RS);
+  GV.CellSize = GV.BoxSize/(1.0*GV.NCELLS);
+  GV.CellStep = GV.CellSize / 2.0;
 
   printf("-----------------------------------------------\n");
   printf("Cosmological parameters:\n");
@@ -163,31 +562,129 @@ int read_binary(void)
 	 GV.BoxSize);
   printf("-----------------------------------------------\n");
 
+  return 0;
+}//read_binary_header
+
+
 
-  for(i=0; i<GV.NTOTALCELLS; i++ )
-    { 
-      nread = fread(&gp[i].GID, sizeof(int), 1, inFile);
+/**************************************************************************************************** 
+NAME: read_binary_cells
+FUNCTION: Reads ncells records of the binary data file into the grid, starting
+at cell m0. The records are read in blocks of BINARY_READ_BLOCK with one fread each.
+INPUT: data file positioned at the record of cell m0, first cell, number of cells
+RETURN: number of cells whose position is not the expected cell centre, -1 if
+the file ends before the last cell
+****************************************************************************************************/
 
-      nread = fread(&pos_aux[0], sizeof(double), 3, inFile);
+long int read_binary_cells(FILE *inFile, long int m0, long int ncells)
+{
+  long int i, l, nblock, nbadpos;
+  size_t nread;
+  double pos_aux[3], potDot_l_app[2];
+  char *block=NULL, *record;
+  
+  block = (char *) malloc((size_t) BINARY_READ_BLOCK*BINARY_RECORD_SIZE);
+  
+  nbadpos = 0;
+  for(i=m0; i<m0+ncells; i+=nblock)
+    {
+      nblock = m0 + ncells - i;
+      if( nblock > BINARY_READ_BLOCK )
+	nblock = BINARY_READ_BLOCK;
+      
+      nread = fread(block, BINARY_RECORD_SIZE, (size_t) nblock, inFile);
+      report_bytes_read((long int) nread*BINARY_RECORD_SIZE);
+      if( nread != (size_t) nblock )
+	printf("  * Only %zu of %ld records read at cell %ld\n", nread, nblock, i);
+      
+      for(l=0; l<(long int) nread; l++)
+	{
+	  /*----- GID, pos[3], DenCon, Pot, PotDot_l_app1, PotDot_l_app2 -----*/
+	  record = block + l*BINARY_RECORD_SIZE;
+	  memcpy(pos_aux, record + sizeof(int), 3*sizeof(double));
+	  memcpy(potDot_l_app, record + BINARY_OFFSET_L_APP1, 2*sizeof(double));
+	  
+	  grid_store(GRID_POTDOT_L_APP1, i+l, potDot_l_app[0]);
+	  grid_store(GRID_POTDOT_L_APP2, i+l, potDot_l_app[1]);
+	  
+	  /*----- Positions are derived from (i,j,k) -----*/
+	  nbadpos += grid_check_position(i+l, pos_aux);
+	  
+	  if((i+l)%100000==0)
+	    {
+	      printf("Reading i=%ld x=%lf y=%lf z=%lf\n", 
+		     i+l, pos_aux[X], pos_aux[Y], pos_aux[Z]);
+	    }//if
+	}//for l
       
-      /*----- Positions -----*/
-      gp[i].pos[X] = pos_aux[X];
-      gp[i].pos[Y] = pos_aux[Y];
-      gp[i].pos[Z] = pos_aux[Z];
-
-      nread = fread(&dummy, sizeof(double), 1, inFile);
-      nread = fread(&dummy, sizeof(double), 1, inFile);  // Gravitational potential in cell
-      nread = fread(&gp[i].potDot_r_l_app1, sizeof(double), 1, inFile);  // PotDot in first approximation
-      nread = fread(&gp[i].potDot_r_l_app2, sizeof(double), 1, inFile);  // PotDot in second approximation
-            
-      if(i%100000==0)
+      if( nread != (size_t) nblock )
 	{
-	  printf("Reading i=%d x=%lf y=%lf z=%lf\n", 
-		 i, gp[i].pos[X], gp[i].pos[Y], gp[i].pos[Z]);
+	  free(block);
+	  return -1;
 	}//if
-
     }//for i
+  
+  free(block);
+  
+  return nbadpos;
+}//read_binary_cells
+
 
+
+/**************************************************************************************************** 
+NAME: read_binary
+FUNCTION: Reads the cells of the columns held by the grid filled by the readers
+(gread) from the binary data file. The header must have been read before with
+read_binary_header. The file has no exact PotDot.
+INPUT: data file
+RETURN: 0, 1 if the file can not be opened or ends before the last cell
+****************************************************************************************************/
+
+int read_binary(char *filename)
+{
+  int own;
+  long int m, m0, ncells, nblock, nbad, nbadpos;
+  FILE *inFile=NULL;
+  
+  inFile = input_open(filename);
+  if( inFile == NULL )
+    {
+      printf("  * The file '%s' doesn't exist!\n", filename);
+      return 1;
+    }//if
+  fseek(inFile, BINARY_HEADER_SIZE + gread->col0*GV.NCELLS*BINARY_RECORD_SIZE, SEEK_SET);
+
+  m0 = gread->col0*GV.NCELLS;
+  ncells = gread->ncols*GV.NCELLS;
+  own = report_progress_start(ncells, "cells read");
+
+  nbadpos = 0;
+  for(m=m0; m<m0+ncells; m+=nblock)
+    {
+      nblock = m0 + ncells - m;
+      if( nblock > BINARY_READ_BLOCK )
+	nblock = BINARY_READ_BLOCK;
+
+      nbad = read_binary_cells(inFile, m, nblock);
+      if( nbad < 0 )
+	break;
+      nbadpos += nbad;
+      if( own )
+	report_progress(nblock);
+    }//for m
+
+  if( own )
+    report_progress_end();
   fclose(inFile);
+  
+  if( m < m0+ncells )
+    {
+      printf("  * The file '%s' does not hold all the cells of the grid!\n", filename);
+      return 1;
+    }//if
+  
+  if( nbadpos > 0 )
+    printf("  * %ld cells are not at the centre (i+0.5)*CellSize assumed for the positions\n", nbadpos);
+  
   return 0;
 }//read_binary
@@ -0,0 +1,371 @@
+/******************************************************************************
+NAME: run_report
+FUNCTION: Timers and counters of the run. The phases (parameters,
+allocation, reading, integration, output) are timed with
+report_begin/report_end around each call, so streaming adds one call per
+slab. Bytes read and written, values of the column interpolants,
+columns integrated and the busy time of every thread in the parallel
+sweeps are counted as the run goes. Long loops report their progress,
+and every REPORT_INTERVAL seconds thread 0 prints the fraction done, the
+estimated time left and the peak resident memory. At exit the report is
+printed and written as JSON to RUN_REPORT_FILE.json (one file per
+process, RUN_REPORT_FILE_<rank>.json, with several MPI processes).
+INPUT: Calls around the phases and in the loops
+RETURN: Run report
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: report_time
+FUNCTION: Wall-clock time
+INPUT: None
+RETURN: seconds
+*************************************************************************************/
+double report_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}//report_time
+
+
+
+/*************************************************************************************
+NAME: report_peak_rss
+FUNCTION: Peak resident memory of the process
+INPUT: None
+RETURN: MB
+*************************************************************************************/
+double report_peak_rss(void)
+{
+  struct rusage ru;
+
+  if( getrusage(RUSAGE_SELF, &ru) != 0 )
+    return 0.0;
+
+  /*+++ ru_maxrss is in kB on Linux +++*/
+  return ru.ru_maxrss/1024.0;
+}//report_peak_rss
+
+
+
+/*************************************************************************************
+NAME: report_hms
+FUNCTION: Writes a time as h:mm:ss
+INPUT: seconds, buffer of at least 32 characters
+RETURN: buffer
+*************************************************************************************/
+char *report_hms(double seconds, char *buff)
+{
+  long int s;
+
+  s = seconds > 0.0 ? (long int) (seconds + 0.5) : 0;
+  snprintf(buff, 32, "%ld:%02ld:%02ld", s/3600, (s/60)%60, s%60);
+
+  return buff;
+}//report_hms
+
+
+
+/*************************************************************************************
+NAME: report_begin
+FUNCTION: Starts a call of a phase
+INPUT: phase (PHASE_*)
+RETURN: none
+*************************************************************************************/
+void report_begin(int phase)
+{
+  RUN.phase_start[phase] = report_time();
+  RUN.phase_calls[phase]++;
+}//report_begin
+
+
+
+/*************************************************************************************
+NAME: report_end
+FUNCTION: Ends the current call of a phase
+INPUT: phase (PHASE_*)
+RETURN: none
+*************************************************************************************/
+void report_end(int phase)
+{
+  RUN.phase_seconds[phase] += report_time() - RUN.phase_start[phase];
+}//report_end
+
+
+
+/*************************************************************************************
+NAME: report_bytes_read
+FUNCTION: Counts bytes read from the data file
+INPUT: bytes
+RETURN: none
+*************************************************************************************/
+void report_bytes_read(long int bytes)
+{
+#pragma omp atomic
+  RUN.bytes_read += bytes;
+}//report_bytes_read
+
+
+
+/*************************************************************************************
+NAME: report_bytes_mapped
+FUNCTION: Counts bytes of the data file mapped in memory. Only the pages the
+sweep touches are actually read, fewer on a restart.
+INPUT: bytes
+RETURN: none
+*************************************************************************************/
+void report_bytes_mapped(long int bytes)
+{
+#pragma omp atomic
+  RUN.bytes_mapped += bytes;
+}//report_bytes_mapped
+
+
+
+/*************************************************************************************
+NAME: report_bytes_written
+FUNCTION: Counts bytes written to the output files
+INPUT: bytes
+RETURN: none
+*************************************************************************************/
+void report_bytes_written(long int bytes)
+{
+#pragma omp atomic
+  RUN.bytes_written += bytes;
+}//report_bytes_written
+
+
+
+/*************************************************************************************
+NAME: report_busy
+FUNCTION: Adds to the busy time of the calling thread the time since t0
+INPUT: time at which the thread started working
+RETURN: none
+*************************************************************************************/
+void report_busy(double t0)
+{
+  int t=0;
+
+#ifdef _OPENMP
+  t = omp_get_thread_num();
+#endif
+  if( t < REPORT_MAX_THREADS )
+    RUN.busy[t] += report_time() - t0;
+}//report_busy
+
+
+
+/*************************************************************************************
+NAME: report_progress_start
+FUNCTION: Starts the progress of a long loop, unless another one is running: a
+loop inside it (the reading of a snapshot while a batch is integrated) is
+then counted only by the outer one
+INPUT: units to do, name of the units
+RETURN: 1 if the progress was started, 0 if another one is running
+*************************************************************************************/
+int report_progress_start(long int total, char *what)
+{
+  if( RUN.progress_total > 0 )
+    return 0;
+
+  snprintf(RUN.progress_what, sizeof(RUN.progress_what), "%s", what);
+  RUN.progress_total = total;
+  RUN.progress_done = 0;
+  RUN.progress_start = report_time();
+  RUN.progress_last = RUN.progress_start;
+
+  return 1;
+}//report_progress_start
+
+
+
+/*************************************************************************************
+NAME: report_progress_end
+FUNCTION: Ends the progress of a loop
+INPUT: None
+RETURN: none
+*************************************************************************************/
+void report_progress_end(void)
+{
+  RUN.progress_what[0] = '\0';
+  RUN.progress_total = 0;
+}//report_progress_end
+
+
+
+/*************************************************************************************
+NAME: report_progress
+FUNCTION: Counts units done in the running loop. Every REPORT_INTERVAL seconds
+thread 0 prints the progress with the estimated time left.
+INPUT: units done since the last call
+RETURN: none
+*************************************************************************************/
+void report_progress(long int n)
+{
+  long int done;
+  double now, elapsed;
+  char telapsed[32], tleft[32];
+
+  if( RUN.progress_total <= 0 )
+    return;
+
+#pragma omp atomic capture
+  done = RUN.progress_done += n;
+
+#ifdef _OPENMP
+  if( omp_get_thread_num() != 0 )
+    return;
+#endif
+
+  now = report_time();
+  if( now - RUN.progress_last < REPORT_INTERVAL )
+    return;
+  RUN.progress_last = now;
+
+  elapsed = now - RUN.progress_start;
+  printf("  %5.1lf%% of %ld %s, %s elapsed, %s left, peak RSS %.1lf MB\n",
+	 100.0*done/RUN.progress_total, RUN.progress_total, RUN.progress_what,
+	 report_hms(elapsed, telapsed),
+	 report_hms(done > 0 ? elapsed*(RUN.progress_total - done)/done : 0.0, tleft),
+	 report_peak_rss());
+  fflush(stdout);
+}//report_progress
+
+
+
+/*************************************************************************************
+NAME: report_columns
+FUNCTION: Counts columns (rays, pixels) integrated, and their progress
+INPUT: number of columns
+RETURN: none
+*************************************************************************************/
+void report_columns(long int n)
+{
+#pragma omp atomic
+  RUN.columns += n;
+
+  report_progress(n);
+}//report_columns
+
+
+
+/*************************************************************************************
+NAME: report_write_json
+FUNCTION: Writes the report as JSON
+INPUT: file name, total time, number of threads
+RETURN: 0, 1 if the file can not be written
+*************************************************************************************/
+int report_write_json(char *filename, double total, int nthreads)
+{
+  static char *names[NPHASES] = {"parameters", "alloc", "read", "integrate", "output"};
+  int p, t;
+  FILE *pf=NULL;
+
+  pf = fopen(filename, "w");
+  if( pf == NULL )
+    {
+      printf("  * The file '%s' can not be written!\n", filename);
+      return 1;
+    }//if
+
+  fprintf(pf, "{\n");
+  fprintf(pf, "  \"ncells\": %d,\n", GV.NCELLS);
+  fprintf(pf, "  \"rank\": %d,\n", GV.RANK);
+  fprintf(pf, "  \"processes\": %d,\n", GV.NPROCS);
+  fprintf(pf, "  \"threads\": %d,\n", nthreads);
+  fprintf(pf, "  \"seconds\": %.6lf,\n", total);
+  fprintf(pf, "  \"phases\": {\n");
+  for(p=0; p<NPHASES; p++)
+    fprintf(pf, "    \"%s\": {\"seconds\": %.6lf, \"calls\": %ld}%s\n",
+	    names[p], RUN.phase_seconds[p], RUN.phase_calls[p], p < NPHASES-1 ? "," : "");
+  fprintf(pf, "  },\n");
+  fprintf(pf, "  \"bytes_read\": %ld,\n", RUN.bytes_read);
+  fprintf(pf, "  \"bytes_mapped\": %ld,\n", RUN.bytes_mapped);
+  fprintf(pf, "  \"bytes_written\": %ld,\n", RUN.bytes_written);
+  fprintf(pf, "  \"interpolant_evaluations\": %ld,\n", RUN.evals);
+  fprintf(pf, "  \"columns\": %ld,\n", RUN.columns);
+  fprintf(pf, "  \"peak_rss_mb\": %.3lf,\n", report_peak_rss());
+  fprintf(pf, "  \"thread_busy_seconds\": [");
+  for(t=0; t<nthreads; t++)
+    fprintf(pf, "%s%.6lf", t > 0 ? ", " : "", RUN.busy[t]);
+  fprintf(pf, "]\n");
+  fprintf(pf, "}\n");
+
+  fclose(pf);
+
+  return 0;
+}//report_write_json
+
+
+
+/*************************************************************************************
+NAME: report_exit
+FUNCTION: Prints the report and writes it as JSON, called at exit
+INPUT: None
+RETURN: none
+*************************************************************************************/
+void report_exit(void)
+{
+  static char *names[NPHASES] = {"Parameters", "Allocation", "Reading", "Integration", "Output"};
+  int p, t, nthreads;
+  double total, busymin, busymax;
+  char filename[1100], thms[32];
+
+  total = report_time() - RUN.start;
+
+  nthreads = 1;
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  if( nthreads > REPORT_MAX_THREADS )
+    nthreads = REPORT_MAX_THREADS;
+
+  busymin = busymax = RUN.busy[0];
+  for(t=1; t<nthreads; t++)
+    {
+      if( RUN.busy[t] < busymin )
+	busymin = RUN.busy[t];
+      if( RUN.busy[t] > busymax )
+	busymax = RUN.busy[t];
+    }//for t
+
+  printf("Run report\n");
+  printf("-----------------------------------------\n");
+  for(p=0; p<NPHASES; p++)
+    printf("%-12s %12.3lf s %8ld calls\n", names[p], RUN.phase_seconds[p], RUN.phase_calls[p]);
+  printf("%-12s %12.3lf s (%s)\n", "Total", total, report_hms(total, thms));
+  printf("Read %.3lf MB, written %.3lf MB\n", RUN.bytes_read/1048576.0, RUN.bytes_written/1048576.0);
+  if( RUN.bytes_mapped > 0 )
+    printf("Mapped %.3lf MB, read in place\n", RUN.bytes_mapped/1048576.0);
+  printf("%ld columns, %ld values of the interpolants\n", RUN.columns, RUN.evals);
+  printf("Thread busy time between %.3lf and %.3lf s\n", busymin, busymax);
+  printf("Peak RSS %.1lf MB\n", report_peak_rss());
+
+  if( GV.NPROCS > 1 )
+    snprintf(filename, sizeof(filename), "%s_%d.json", RUN_REPORT_FILE, GV.RANK);
+  else
+    snprintf(filename, sizeof(filename), "%s.json", RUN_REPORT_FILE);
+  if( report_write_json(filename, total, nthreads) == 0 )
+    printf("Report written to %s\n", filename);
+  printf("-----------------------------------------\n");
+}//report_exit
+
+
+
+/*************************************************************************************
+NAME: report_start
+FUNCTION: Starts the report of the run, written at exit
+INPUT: None
+RETURN: 0
+*************************************************************************************/
+int report_start(void)
+{
+  memset(&RUN, 0, sizeof(RUN));
+  RUN.start = report_time();
+  atexit(report_exit);
+
+  return 0;
+}//report_start
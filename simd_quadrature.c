@@ -0,0 +1,505 @@
+/******************************************************************************
+NAME: simd_quadrature
+FUNCTION: Batched Simpson integration of SIMD_BATCH adjacent (i,j) columns
+in lockstep. All the columns of a field share the same knots in z, so the
+Simpson samples, the knot interval of each one and its position in the
+interval are computed once per field (struct simpson_plan). The columns of
+a batch are interleaved, batch[k*SIMD_BATCH + lane], so every sample is
+one broadcast of t and two vector loads of the knot values, and the
+lanes are summed in the same order as simpson_column, giving the same
+values as the scalar loop over the GSL linear spline. The kernels are
+compiled without contraction, a fused multiply-add in the interpolation
+of the samples would round them differently. The kernel is chosen at
+run time: AVX-512 or AVX2 when the CPU supports them, and a portable
+loop over the lanes otherwise. With STORAGE = float the lanes
+are added up with Kahan sums, as simpson_column does then.
+INPUT: Plans of the registered fields, interleaved columns
+RETURN: Simpson integrals of the columns of a batch
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: simpson_plan_free
+FUNCTION: Frees the samples of a plan and leaves it empty
+INPUT: plan
+RETURN: none
+*************************************************************************************/
+void simpson_plan_free(struct simpson_plan *plan)
+{
+  free(plan->k);
+  free(plan->t);
+
+  plan->k = NULL;
+  plan->t = NULL;
+  plan->nsamples = 0;
+}//simpson_plan_free
+
+
+
+/*************************************************************************************
+NAME: simpson_plan_build
+FUNCTION: Computes the Simpson samples between a and b with the same steps as
+simpson_column, and the knot interval containing each one as the GSL
+accelerator finds it
+INPUT: plan, knots in z (increasing), number of knots, limits of integration,
+number of intervals (even)
+RETURN: 0, 1 if a sample is outside the knots (the plan is left empty)
+*************************************************************************************/
+int simpson_plan_build(struct simpson_plan *plan, double *z, int nknots,
+		       double a, double b, int Nsamples)
+{
+  int i, s, lo, hi, mid;
+  double x0, xie, xio, *x;
+
+  plan->nsamples = 0;
+  plan->neven    = 0;
+  plan->k        = NULL;
+  plan->t        = NULL;
+  plan->hstep    = (b-a)/(Nsamples*1.0);
+
+  x = (double *) malloc((size_t) (Nsamples+1)*sizeof(double));
+
+  /*+++ x0, even samples, odd samples and xn, as in simpson_column +++*/
+  s = 0;
+  x0 = a;
+  x[s++] = x0;
+
+  xie = x0 + 2.0*plan->hstep;
+  for(i=2; i<=(Nsamples-2); i=i+2)
+    {
+      x[s++] = xie;
+      xie = xie + 2.0*plan->hstep;
+    }//for i
+  plan->neven = s - 1;
+
+  xio = x0 + plan->hstep;
+  for(i=1; i<=Nsamples-1; i=i+2)
+    {
+      x[s++] = xio;
+      xio = xio + 2.0*plan->hstep;
+    }//for i
+
+  x[s++] = b;
+
+  plan->k = (int *) malloc((size_t) s*sizeof(int));
+  plan->t = (double *) malloc((size_t) s*sizeof(double));
+
+  for(i=0; i<s; i++)
+    {
+      if( x[i] < z[0] || x[i] > z[nknots-1] )
+	{
+	  free(x);
+	  simpson_plan_free(plan);
+	  return 1;
+	}//if
+
+      /*+++ Last interval with z[lo] <= x, the last one for x = z[nknots-1] +++*/
+      lo = 0;
+      hi = nknots-1;
+      while( hi - lo > 1 )
+	{
+	  mid = (lo + hi)/2;
+	  if( z[mid] > x[i] )
+	    hi = mid;
+	  else
+	    lo = mid;
+	}//while
+
+      plan->k[i] = lo;
+      plan->t[i] = (x[i] - z[lo])/(z[lo+1] - z[lo]);
+    }//for i
+
+  plan->nsamples = s;
+  free(x);
+
+  return 0;
+}//simpson_plan_build
+
+
+
+/*+++ No fused multiply-adds in the kernels: every lane must round as simpson_column +++*/
+#pragma GCC push_options
+#pragma GCC optimize ("fp-contract=off")
+
+/*************************************************************************************
+NAME: simpson_batch_scalar
+FUNCTION: Portable batched Simpson kernel, one loop over the lanes per sample
+INPUT: plan, interleaved columns, integrals of the SIMD_BATCH lanes
+RETURN: none
+*************************************************************************************/
+void simpson_batch_scalar(struct simpson_plan *plan, double *fb, double *integ)
+{
+  int s, l, last;
+  double t, *lo;
+  double f0[SIMD_BATCH], feven[SIMD_BATCH], fodd[SIMD_BATCH], fn[SIMD_BATCH];
+
+  last = plan->nsamples-1;
+
+  lo = fb + plan->k[0]*SIMD_BATCH;
+  t  = plan->t[0];
+  for(l=0; l<SIMD_BATCH; l++)
+    {
+      f0[l] = lo[l] + t*(lo[SIMD_BATCH+l] - lo[l]);
+      feven[l] = 0.0;
+      fodd[l] = 0.0;
+    }//for l
+
+  for(s=1; s<=plan->neven; s++)
+    {
+      lo = fb + plan->k[s]*SIMD_BATCH;
+      t  = plan->t[s];
+      for(l=0; l<SIMD_BATCH; l++)
+	feven[l] = feven[l] + (lo[l] + t*(lo[SIMD_BATCH+l] - lo[l]));
+    }//for s
+
+  for(s=plan->neven+1; s<last; s++)
+    {
+      lo = fb + plan->k[s]*SIMD_BATCH;
+      t  = plan->t[s];
+      for(l=0; l<SIMD_BATCH; l++)
+	fodd[l] = fodd[l] + (lo[l] + t*(lo[SIMD_BATCH+l] - lo[l]));
+    }//for s
+
+  lo = fb + plan->k[last]*SIMD_BATCH;
+  t  = plan->t[last];
+  for(l=0; l<SIMD_BATCH; l++)
+    {
+      fn[l] = lo[l] + t*(lo[SIMD_BATCH+l] - lo[l]);
+      integ[l] = (plan->hstep/3.0)*(f0[l] + 2.0*feven[l] + 4.0*fodd[l] + fn[l]);
+    }//for l
+}//simpson_batch_scalar
+
+
+
+/*************************************************************************************
+NAME: simpson_batch_kahan
+FUNCTION: Portable batched Simpson kernel adding up the even and odd samples of
+every lane with Kahan sums, for the grids stored as floats
+INPUT: plan, interleaved columns, integrals of the SIMD_BATCH lanes
+RETURN: none
+*************************************************************************************/
+void simpson_batch_kahan(struct simpson_plan *plan, double *fb, double *integ)
+{
+  int s, l, last;
+  double t, v, y, sum, *lo;
+  double f0[SIMD_BATCH], feven[SIMD_BATCH], fodd[SIMD_BATCH], fn[SIMD_BATCH];
+  double ceven[SIMD_BATCH], codd[SIMD_BATCH];
+
+  last = plan->nsamples-1;
+
+  lo = fb + plan->k[0]*SIMD_BATCH;
+  t  = plan->t[0];
+  for(l=0; l<SIMD_BATCH; l++)
+    {
+      f0[l] = lo[l] + t*(lo[SIMD_BATCH+l] - lo[l]);
+      feven[l] = 0.0;
+      fodd[l] = 0.0;
+      ceven[l] = 0.0;
+      codd[l] = 0.0;
+    }//for l
+
+  for(s=1; s<=plan->neven; s++)
+    {
+      lo = fb + plan->k[s]*SIMD_BATCH;
+      t  = plan->t[s];
+      for(l=0; l<SIMD_BATCH; l++)
+	{
+	  v = lo[l] + t*(lo[SIMD_BATCH+l] - lo[l]);
+	  y = v - ceven[l];
+	  sum = feven[l] + y;
+	  ceven[l] = (sum - feven[l]) - y;
+	  feven[l] = sum;
+	}//for l
+    }//for s
+
+  for(s=plan->neven+1; s<last; s++)
+    {
+      lo = fb + plan->k[s]*SIMD_BATCH;
+      t  = plan->t[s];
+      for(l=0; l<SIMD_BATCH; l++)
+	{
+	  v = lo[l] + t*(lo[SIMD_BATCH+l] - lo[l]);
+	  y = v - codd[l];
+	  sum = fodd[l] + y;
+	  codd[l] = (sum - fodd[l]) - y;
+	  fodd[l] = sum;
+	}//for l
+    }//for s
+
+  lo = fb + plan->k[last]*SIMD_BATCH;
+  t  = plan->t[last];
+  for(l=0; l<SIMD_BATCH; l++)
+    {
+      fn[l] = lo[l] + t*(lo[SIMD_BATCH+l] - lo[l]);
+      integ[l] = (plan->hstep/3.0)*(f0[l] + 2.0*feven[l] + 4.0*fodd[l] + fn[l]);
+    }//for l
+}//simpson_batch_kahan
+
+
+
+#ifdef SIMD_X86
+/*************************************************************************************
+NAME: simpson_sample_avx2
+FUNCTION: Values of four lanes at sample s
+INPUT: plan, interleaved columns shifted to the first lane, sample
+RETURN: values
+*************************************************************************************/
+static inline __attribute__((target("avx2")))
+__m256d simpson_sample_avx2(struct simpson_plan *plan, double *fb, int s)
+{
+  double *lo;
+  __m256d ylo, yhi;
+
+  lo  = fb + plan->k[s]*SIMD_BATCH;
+  ylo = _mm256_loadu_pd(lo);
+  yhi = _mm256_loadu_pd(lo + SIMD_BATCH);
+
+  return _mm256_add_pd(ylo, _mm256_mul_pd(_mm256_set1_pd(plan->t[s]), _mm256_sub_pd(yhi, ylo)));
+}//simpson_sample_avx2
+
+
+
+/*************************************************************************************
+NAME: simpson_batch_avx2
+FUNCTION: Batched Simpson kernel with AVX2, the SIMD_BATCH lanes in two
+registers of four columns
+INPUT: plan, interleaved columns, integrals of the SIMD_BATCH lanes
+RETURN: none
+*************************************************************************************/
+__attribute__((target("avx2")))
+void simpson_batch_avx2(struct simpson_plan *plan, double *fb, double *integ)
+{
+  int s, h, last;
+  __m256d f0, feven, fodd, fn, sum;
+
+  last = plan->nsamples-1;
+
+  for(h=0; h<SIMD_BATCH; h+=4)
+    {
+      f0 = simpson_sample_avx2(plan, fb+h, 0);
+
+      feven = _mm256_setzero_pd();
+      for(s=1; s<=plan->neven; s++)
+	feven = _mm256_add_pd(feven, simpson_sample_avx2(plan, fb+h, s));
+
+      fodd = _mm256_setzero_pd();
+      for(s=plan->neven+1; s<last; s++)
+	fodd = _mm256_add_pd(fodd, simpson_sample_avx2(plan, fb+h, s));
+
+      fn = simpson_sample_avx2(plan, fb+h, last);
+
+      sum = _mm256_add_pd(f0, _mm256_mul_pd(_mm256_set1_pd(2.0), feven));
+      sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_set1_pd(4.0), fodd));
+      sum = _mm256_add_pd(sum, fn);
+      _mm256_storeu_pd(integ+h, _mm256_mul_pd(_mm256_set1_pd(plan->hstep/3.0), sum));
+    }//for h
+}//simpson_batch_avx2
+
+
+/*************************************************************************************
+NAME: simpson_batch_avx2_kahan
+FUNCTION: AVX2 kernel adding up the even and odd samples of every lane with
+Kahan sums, for the grids stored as floats
+INPUT: plan, interleaved columns, integrals of the SIMD_BATCH lanes
+RETURN: none
+*************************************************************************************/
+__attribute__((target("avx2")))
+void simpson_batch_avx2_kahan(struct simpson_plan *plan, double *fb, double *integ)
+{
+  int s, h, last;
+  __m256d f0, feven, fodd, fn, ceven, codd, y, sum;
+
+  last = plan->nsamples-1;
+
+  for(h=0; h<SIMD_BATCH; h+=4)
+    {
+      f0 = simpson_sample_avx2(plan, fb+h, 0);
+
+      feven = _mm256_setzero_pd();
+      ceven = _mm256_setzero_pd();
+      for(s=1; s<=plan->neven; s++)
+	{
+	  y     = _mm256_sub_pd(simpson_sample_avx2(plan, fb+h, s), ceven);
+	  sum   = _mm256_add_pd(feven, y);
+	  ceven = _mm256_sub_pd(_mm256_sub_pd(sum, feven), y);
+	  feven = sum;
+	}//for s
+
+      fodd = _mm256_setzero_pd();
+      codd = _mm256_setzero_pd();
+      for(s=plan->neven+1; s<last; s++)
+	{
+	  y    = _mm256_sub_pd(simpson_sample_avx2(plan, fb+h, s), codd);
+	  sum  = _mm256_add_pd(fodd, y);
+	  codd = _mm256_sub_pd(_mm256_sub_pd(sum, fodd), y);
+	  fodd = sum;
+	}//for s
+
+      fn = simpson_sample_avx2(plan, fb+h, last);
+
+      sum = _mm256_add_pd(f0, _mm256_mul_pd(_mm256_set1_pd(2.0), feven));
+      sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_set1_pd(4.0), fodd));
+      sum = _mm256_add_pd(sum, fn);
+      _mm256_storeu_pd(integ+h, _mm256_mul_pd(_mm256_set1_pd(plan->hstep/3.0), sum));
+    }//for h
+}//simpson_batch_avx2_kahan
+
+
+
+/*************************************************************************************
+NAME: simpson_sample_avx512
+FUNCTION: Values of the SIMD_BATCH lanes at sample s
+INPUT: plan, interleaved columns, sample
+RETURN: values
+*************************************************************************************/
+static inline __attribute__((target("avx512f")))
+__m512d simpson_sample_avx512(struct simpson_plan *plan, double *fb, int s)
+{
+  double *lo;
+  __m512d ylo, yhi;
+
+  lo  = fb + plan->k[s]*SIMD_BATCH;
+  ylo = _mm512_loadu_pd(lo);
+  yhi = _mm512_loadu_pd(lo + SIMD_BATCH);
+
+  return _mm512_add_pd(ylo, _mm512_mul_pd(_mm512_set1_pd(plan->t[s]), _mm512_sub_pd(yhi, ylo)));
+}//simpson_sample_avx512
+
+
+
+/*************************************************************************************
+NAME: simpson_batch_avx512
+FUNCTION: Batched Simpson kernel with AVX-512, the SIMD_BATCH lanes in one register
+INPUT: plan, interleaved columns, integrals of the SIMD_BATCH lanes
+RETURN: none
+*************************************************************************************/
+__attribute__((target("avx512f")))
+void simpson_batch_avx512(struct simpson_plan *plan, double *fb, double *integ)
+{
+  int s, last;
+  __m512d f0, feven, fodd, fn, sum;
+
+  last = plan->nsamples-1;
+
+  f0 = simpson_sample_avx512(plan, fb, 0);
+
+  feven = _mm512_setzero_pd();
+  for(s=1; s<=plan->neven; s++)
+    feven = _mm512_add_pd(feven, simpson_sample_avx512(plan, fb, s));
+
+  fodd = _mm512_setzero_pd();
+  for(s=plan->neven+1; s<last; s++)
+    fodd = _mm512_add_pd(fodd, simpson_sample_avx512(plan, fb, s));
+
+  fn = simpson_sample_avx512(plan, fb, last);
+
+  sum = _mm512_add_pd(f0, _mm512_mul_pd(_mm512_set1_pd(2.0), feven));
+  sum = _mm512_add_pd(sum, _mm512_mul_pd(_mm512_set1_pd(4.0), fodd));
+  sum = _mm512_add_pd(sum, fn);
+  _mm512_storeu_pd(integ, _mm512_mul_pd(_mm512_set1_pd(plan->hstep/3.0), sum));
+}//simpson_batch_avx512
+
+
+/*************************************************************************************
+NAME: simpson_batch_avx512_kahan
+FUNCTION: AVX-512 kernel adding up the even and odd samples of every lane with
+Kahan sums, for the grids stored as floats
+INPUT: plan, interleaved columns, integrals of the SIMD_BATCH lanes
+RETURN: none
+*************************************************************************************/
+__attribute__((target("avx512f")))
+void simpson_batch_avx512_kahan(struct simpson_plan *plan, double *fb, double *integ)
+{
+  int s, last;
+  __m512d f0, feven, fodd, fn, ceven, codd, y, sum;
+
+  last = plan->nsamples-1;
+
+  f0 = simpson_sample_avx512(plan, fb, 0);
+
+  feven = _mm512_setzero_pd();
+  ceven = _mm512_setzero_pd();
+  for(s=1; s<=plan->neven; s++)
+    {
+      y     = _mm512_sub_pd(simpson_sample_avx512(plan, fb, s), ceven);
+      sum   = _mm512_add_pd(feven, y);
+      ceven = _mm512_sub_pd(_mm512_sub_pd(sum, feven), y);
+      feven = sum;
+    }//for s
+
+  fodd = _mm512_setzero_pd();
+  codd = _mm512_setzero_pd();
+  for(s=plan->neven+1; s<last; s++)
+    {
+      y    = _mm512_sub_pd(simpson_sample_avx512(plan, fb, s), codd);
+      sum  = _mm512_add_pd(fodd, y);
+      codd = _mm512_sub_pd(_mm512_sub_pd(sum, fodd), y);
+      fodd = sum;
+    }//for s
+
+  fn = simpson_sample_avx512(plan, fb, last);
+
+  sum = _mm512_add_pd(f0, _mm512_mul_pd(_mm512_set1_pd(2.0), feven));
+  sum = _mm512_add_pd(sum, _mm512_mul_pd(_mm512_set1_pd(4.0), fodd));
+  sum = _mm512_add_pd(sum, fn);
+  _mm512_storeu_pd(integ, _mm512_mul_pd(_mm512_set1_pd(plan->hstep/3.0), sum));
+}//simpson_batch_avx512_kahan
+#endif
+
+#pragma GCC pop_options
+
+
+
+/*************************************************************************************
+NAME: simpson_batch_select
+FUNCTION: Chooses the batched Simpson kernel: the one asked for by SIMD in the
+parameters file (GV.SIMD_MODE), or the widest one supported by the CPU, falling
+back to narrower kernels when the CPU lacks the instructions. Grids stored as
+floats use the Kahan variant of the chosen kernel.
+INPUT: None
+RETURN: 0
+*************************************************************************************/
+int simpson_batch_select(void)
+{
+  int kahan;
+  char *name;
+
+  kahan = (GV.STORAGE == STORAGE_FLOAT);
+
+  simpson_batch = kahan ? simpson_batch_kahan : simpson_batch_scalar;
+  name = kahan ? "kahan" : "scalar";
+
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+
+  if( GV.SIMD_MODE == SIMD_AUTO || GV.SIMD_MODE == SIMD_AVX512 )
+    {
+      if( __builtin_cpu_supports("avx512f") )
+	{
+	  simpson_batch = kahan ? simpson_batch_avx512_kahan : simpson_batch_avx512;
+	  name = kahan ? "avx512-kahan" : "avx512";
+	}//if
+      else if( __builtin_cpu_supports("avx2") )
+	{
+	  simpson_batch = kahan ? simpson_batch_avx2_kahan : simpson_batch_avx2;
+	  name = kahan ? "avx2-kahan" : "avx2";
+	}//else if
+    }//if
+  else if( GV.SIMD_MODE == SIMD_AVX2 )
+    {
+      if( __builtin_cpu_supports("avx2") )
+	{
+	  simpson_batch = kahan ? simpson_batch_avx2_kahan : simpson_batch_avx2;
+	  name = kahan ? "avx2-kahan" : "avx2";
+	}//if
+    }//else if
+#endif
+
+  if( (GV.SIMD_MODE == SIMD_AVX512 && strncmp(name, "avx512", 6) != 0) ||
+      (GV.SIMD_MODE == SIMD_AVX2 && strncmp(name, "avx2", 4) != 0) )
+    printf("  * The requested SIMD kernel is not supported by this CPU\n");
+
+  printf("Simpson kernel=%s, %d columns per batch\n", name, SIMD_BATCH);
+
+  return 0;
+}//simpson_batch_select
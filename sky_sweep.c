@@ -0,0 +1,361 @@
+/******************************************************************************
+NAME: sky_sweep
+FUNCTION: Full-sky ISW maps seen by an observer. One radial ray per pixel of
+a HEALPix RING map of SKY_NSIDE goes from the observer OBSERVER out to the
+comoving distance RMAX through the periodic replicas of the box. Every
+registered field is sampled trilinearly at the centres of NKNOTS equal
+steps of the ray, which then takes the place of a column: it is
+interpolated and integrated between 0 and RMAX with the machinery of
+column_interp.c, so every INTEGRATION and INTERP choice applies, and the
+map keeps a_SF times the integral. The pixels are handed out to the
+threads in Morton order of their directions, so the rays traced together
+are neighbours on the sky and read the same blocks of the grid.
+Output, in RING order: one ASCII file per field with pix, theta, phi and
+the ISW value (and its error in INTEG_ADAPTIVE mode), or in binary all
+the maps in SKY_OUTPUT_FILE after a header like the one of the SW maps:
+  char magic[8]      "SWSKY001"
+  int  NSIDE, nmaps
+  double BoxSize, Omega_M0, Omega_L0, z_RS, H0, a_SF
+  double OBSERVER[3], RMAX
+  char names[nmaps][SW_NAME_LEN]
+INPUT: The whole grid gp, GV.SKY_NSIDE, GV.OBSERVER, GV.RMAX
+RETURN: One sky map per registered field
+******************************************************************************/
+
+
+/*************************************************************************************
+NAME: healpix_pix2vec_ring
+FUNCTION: Direction of the centre of a pixel of a HEALPix map in RING ordering
+INPUT: NSIDE, pixel, unit vector
+RETURN: 0
+*************************************************************************************/
+int healpix_pix2vec_ring(long int nside, long int pix, double vec[3])
+{
+  long int npix, ncap, ip, iring, iphi;
+  double z, phi, fodd, sth;
+
+  npix = 12*nside*nside;
+  ncap = 2*nside*(nside-1);
+
+  if( pix < ncap )
+    {
+      /*+++ North polar cap +++*/
+      iring = (1 + (long int) sqrt(1.0 + 2.0*pix)) >> 1;
+      if( 2*iring*(iring-1) > pix )
+	iring--;
+      iphi  = pix + 1 - 2*iring*(iring-1);
+      z     = 1.0 - (double) (iring*iring)*4.0/npix;
+      phi   = (iphi - 0.5)*0.5*M_PI/iring;
+    }//if
+  else if( pix < npix - ncap )
+    {
+      /*+++ Equatorial belt +++*/
+      ip    = pix - ncap;
+      iring = ip/(4*nside) + nside;
+      iphi  = ip%(4*nside) + 1;
+      fodd  = ((iring + nside) & 1) ? 1.0 : 0.5;
+      z     = (2*nside - iring)*2.0/(3.0*nside);
+      phi   = (iphi - fodd)*M_PI/(2.0*nside);
+    }//else if
+  else
+    {
+      /*+++ South polar cap +++*/
+      ip    = npix - pix;
+      iring = (1 + (long int) sqrt(2.0*ip - 1.0)) >> 1;
+      if( 2*iring*(iring+1) < ip )
+	iring++;
+      iphi  = 4*iring + 1 - (ip - 2*iring*(iring-1));
+      z     = -1.0 + (double) (iring*iring)*4.0/npix;
+      phi   = (iphi - 0.5)*0.5*M_PI/iring;
+    }//else
+
+  sth = sqrt((1.0 - z)*(1.0 + z));
+  vec[X] = sth*cos(phi);
+  vec[Y] = sth*sin(phi);
+  vec[Z] = z;
+
+  return 0;
+}//healpix_pix2vec_ring
+
+
+
+/*************************************************************************************
+NAME: morton_key
+FUNCTION: Morton (Z-order) key of a point of the unit cube, 21 bits per axis
+INPUT: coordinates in [0,1]
+RETURN: key
+*************************************************************************************/
+unsigned long long int morton_key(double x, double y, double z)
+{
+  int b;
+  unsigned long long int ix, iy, iz, key;
+
+  ix = (unsigned long long int) (x*2097151.0);
+  iy = (unsigned long long int) (y*2097151.0);
+  iz = (unsigned long long int) (z*2097151.0);
+
+  key = 0;
+  for(b=20; b>=0; b--)
+    key = (key << 3) | (((ix >> b) & 1) << 2) | (((iy >> b) & 1) << 1) | ((iz >> b) & 1);
+
+  return key;
+}//morton_key
+
+
+
+/*************************************************************************************
+NAME: compare_sky_order
+FUNCTION: Orders the pixels by the Morton key of their directions, for qsort
+INPUT: two pixels
+RETURN: -1, 0 or 1
+*************************************************************************************/
+int compare_sky_order(const void *a, const void *b)
+{
+  const struct sky_order *pa = (const struct sky_order *) a;
+  const struct sky_order *pb = (const struct sky_order *) b;
+
+  if( pa->key < pb->key )
+    return -1;
+  if( pa->key > pb->key )
+    return 1;
+
+  return 0;
+}//compare_sky_order
+
+
+
+/*************************************************************************************
+NAME: sky_rmax
+FUNCTION: Comoving distance reached by the rays, RMAX or BoxSize when it is 0
+INPUT: None
+RETURN: distance
+*************************************************************************************/
+double sky_rmax(void)
+{
+  return GV.RMAX > 0.0 ? GV.RMAX : GV.BoxSize;
+}//sky_rmax
+
+
+
+/*************************************************************************************
+NAME: sweep_SW_sky
+FUNCTION: Computes a_SF times the integral between 0 and RMAX along the ray of every
+pixel of the sky, for all the registered fields (RMAX=0 stands for BoxSize).
+Pixel p goes to SW_map[p]. The pixels of the checkpoint of an earlier run are
+skipped.
+INPUT: none
+RETURN: 0
+*************************************************************************************/
+int sweep_SW_sky(void)
+{
+  long int p, npix;
+  int nknots, Nsamples;
+  double rmax;
+  struct sky_order *order;
+
+  npix = 12*GV.SKY_NSIDE*GV.SKY_NSIDE;
+  rmax = sky_rmax();
+
+  /*+++ One knot per cell crossed (enough for every INTERP), Simpson as dense as along the columns +++*/
+  nknots = (int) ceil(rmax/GV.CellSize);
+  if( nknots < 5 )
+    nknots = 5;
+  Nsamples = 2*(int) ceil(0.5*INTEGRATION_NSTEPS*nknots/(double) GV.NCELLS);
+
+  printf("Sky of %ld pixels, rays of %d knots up to %lf from (%lf, %lf, %lf)\n",
+	 npix, nknots, rmax, GV.OBSERVER[X], GV.OBSERVER[Y], GV.OBSERVER[Z]);
+
+  /*+++ Pixels in Morton order of their directions +++*/
+  order = (struct sky_order *) malloc((size_t) npix*sizeof(struct sky_order));
+
+#pragma omp parallel for
+  for(p=0; p<npix; p++)
+    {
+      double vec[3];
+
+      healpix_pix2vec_ring(GV.SKY_NSIDE, p, vec);
+      order[p].pix = p;
+      order[p].key = morton_key(0.5*(vec[X] + 1.0), 0.5*(vec[Y] + 1.0), 0.5*(vec[Z] + 1.0));
+    }//for p
+
+  qsort(order, (size_t) npix, sizeof(struct sky_order), compare_sky_order);
+
+#pragma omp parallel
+  {
+    struct column_interp ci;
+    int k, f, a, c8;
+    long int pix, m[8];
+    double t0, *r, *z, *values, vec[3], pos[3], w[8], value, integ;
+
+    column_interp_alloc(&ci, nknots);
+    r      = (double *) malloc((size_t) nknots*sizeof(double));
+    z      = (double *) malloc((size_t) nknots*sizeof(double));
+    values = (double *) malloc((size_t) NSWFIELDS*nknots*sizeof(double));
+
+    /*+++ Samples at the centres of the steps, knots there with the ends moved to 0 and RMAX +++*/
+    for(k=0; k<nknots; k++)
+      {
+	r[k] = (k + 0.5)*rmax/nknots;
+	z[k] = r[k];
+      }//for k
+    z[0] = 0.0;
+    z[nknots-1] = rmax;
+    t0 = report_time();
+
+#pragma omp for schedule(dynamic, SKY_CHUNK) nowait
+    for(p=0; p<npix; p++)
+      {
+	pix = order[p].pix;
+	if( checkpoint_done(pix) )
+	  continue;
+
+	healpix_pix2vec_ring(GV.SKY_NSIDE, pix, vec);
+
+	for(k=0; k<nknots; k++)
+	  {
+	    for(a=0; a<3; a++)
+	      pos[a] = GV.OBSERVER[a] + r[k]*vec[a];
+
+	    trilinear_cells(pos, m, w);
+
+	    for(f=0; f<NSWFIELDS; f++)
+	      {
+		value = 0.0;
+		for(c8=0; c8<8; c8++)
+		  value = value + w[c8]*grid_value(SWF[f].field, m[c8]);
+		values[f*nknots + k] = value;
+	      }//for f
+	  }//for k
+
+	for(f=0; f<NSWFIELDS; f++)
+	  {
+	    column_interp_build(&ci, z, &values[f*nknots]);
+	    integ = integrate_column_n(&ci, 0.0, rmax, Nsamples, &SWF[f].CheckMaxDiff);
+	    SWF[f].SW_map[pix] = GV.a_SF*integ;
+
+	    if( SWF[f].SW_err != NULL )
+	      {
+		SWF[f].SW_err[pix] = GV.a_SF*ci.error;
+#pragma omp critical (integ_check)
+		{
+		  if( SWF[f].SW_err[pix] > SWF[f].MaxError )
+		    SWF[f].MaxError = SWF[f].SW_err[pix];
+		  if( ci.status != 0 )
+		    SWF[f].NFailed++;
+		}
+	      }//if
+
+	    if( GV.STORAGE == STORAGE_CHECK )
+	      storage_check_column(&ci, 0.0, rmax, Nsamples, integ, &SWF[f].StorageMaxDiff);
+	  }//for f
+
+	checkpoint_mark(pix, 1);
+	report_columns(1);
+      }//for p
+
+    report_busy(t0);
+    free(values);
+    free(z);
+    free(r);
+    column_interp_free(&ci);
+  }//omp parallel
+
+  free(order);
+
+  return 0;
+}//sweep_SW_sky
+
+
+
+/*************************************************************************************
+NAME: write_sky_maps
+FUNCTION: Writes the sky maps of all the registered fields in RING order
+INPUT: None
+RETURN: 0, 1 if a file can not be opened
+*************************************************************************************/
+int write_sky_maps(void)
+{
+  int f, nmaps, nside;
+  long int p, npix;
+  double params[10], vec[3];
+  char filename[1100], name[SW_NAME_LEN];
+  FILE *pf=NULL;
+
+  npix = 12*GV.SKY_NSIDE*GV.SKY_NSIDE;
+
+  /*+++ One ASCII file per field +++*/
+  if( GV.OUTPUT_FORMAT == OUTPUT_ASCII )
+    {
+      for(f=0; f<NSWFIELDS; f++)
+	{
+	  snprintf(filename, sizeof(filename), "./ISW_sky_%.*s.dat", SW_NAME_LEN, SWF[f].name);
+	  pf = sw_output_file(filename, "w", BINARY_OUTPUT_BUFFER);
+	  if( pf == NULL )
+	    return 1;
+
+	  if( SWF[f].SW_err != NULL )
+	    fprintf(pf, "#pix\t theta\t phi\t ISW\t ISW_Error\n");
+	  else
+	    fprintf(pf, "#pix\t theta\t phi\t ISW\n");
+
+	  for(p=0; p<npix; p++)
+	    {
+	      healpix_pix2vec_ring(GV.SKY_NSIDE, p, vec);
+	      fprintf(pf, "%12ld %16.10f %16.10f %16.8e", p,
+		      acos(vec[Z]), atan2(vec[Y], vec[X]) < 0.0 ? atan2(vec[Y], vec[X]) + 2.0*M_PI : atan2(vec[Y], vec[X]),
+		      SWF[f].SW_map[p]);
+	      if( SWF[f].SW_err != NULL )
+		fprintf(pf, " %16.8e", SWF[f].SW_err[p]);
+	      fprintf(pf, "\n");
+	    }//for p
+
+	  report_bytes_written(ftell(pf));
+	  fclose(pf);
+	}//for f
+
+      return 0;
+    }//if
+
+  /*+++ All the maps in one binary file +++*/
+  pf = sw_output_file(SKY_OUTPUT_FILE, "w", BINARY_OUTPUT_BUFFER);
+  if( pf == NULL )
+    return 1;
+
+  nside = (int) GV.SKY_NSIDE;
+  nmaps = GV.INTEG_MODE == INTEG_ADAPTIVE ? 2*NSWFIELDS : NSWFIELDS;
+  params[0] = GV.BoxSize;
+  params[1] = GV.Omega_M0;
+  params[2] = GV.Omega_L0;
+  params[3] = GV.z_RS;
+  params[4] = GV.H0;
+  params[5] = GV.a_SF;
+  params[6] = GV.OBSERVER[X];
+  params[7] = GV.OBSERVER[Y];
+  params[8] = GV.OBSERVER[Z];
+  params[9] = sky_rmax();
+
+  fwrite("SWSKY001", 1, 8, pf);
+  fwrite(&nside, sizeof(int), 1, pf);
+  fwrite(&nmaps, sizeof(int), 1, pf);
+  fwrite(params, sizeof(double), 10, pf);
+  for(f=0; f<nmaps; f++)
+    {
+      memset(name, 0, SW_NAME_LEN);
+      if( f < NSWFIELDS )
+	snprintf(name, SW_NAME_LEN, "%.*s", SW_NAME_LEN-1, SWF[f].name);
+      else
+	snprintf(name, SW_NAME_LEN, "%.*s_err", SW_NAME_LEN-5, SWF[f-NSWFIELDS].name);
+      fwrite(name, 1, SW_NAME_LEN, pf);
+    }//for f
+
+  for(f=0; f<NSWFIELDS; f++)
+    fwrite(SWF[f].SW_map, sizeof(double), (size_t) npix, pf);
+  if( nmaps > NSWFIELDS )
+    for(f=0; f<NSWFIELDS; f++)
+      fwrite(SWF[f].SW_err, sizeof(double), (size_t) npix, pf);
+
+  report_bytes_written(ftell(pf));
+  fclose(pf);
+
+  return 0;
+}//write_sky_maps
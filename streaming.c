@@ -0,0 +1,266 @@
+/******************************************************************************
+NAME: streaming
+FUNCTION: Streaming sweep with O(NCELLS) memory. The cells are stored in C
+order with k fastest, so every (i,j) column is a contiguous run of NCELLS
+records in the ASCII and binary files. A slab of columns is read into the
+grid, integrated, written to the output files and dropped before the next
+slab is read, so the whole grid is never in memory and the integration
+starts as soon as the first slab is read.
+With STREAM_PREFETCH > 0 the slabs go through a ring of STREAM_PREFETCH+1
+grids: a reader thread fills the free slots ahead while the slab in gp is
+integrated and written, so the run takes about the longest of reading and
+computing instead of their sum.
+INPUT: Registered fields, GV.FILENAME, number of columns per slab
+RETURN: Output files of all the registered fields
+******************************************************************************/
+
+
+/*+++ Ring of slabs shared by the reader thread and the sweep +++*/
+struct stream_ring
+{
+  struct grid slot[STREAM_RING_MAX]; // Grids of the slabs
+  int nslots;                        // Slots in use
+  long int slab;                     // Columns per slab
+  long int ncolumns;                 // Columns of the whole grid
+  long int nslabs;                   // Slabs of the whole grid
+  FILE *inFile;                      // Data file, past its header
+  long int nread;                    // Slabs read so far
+  long int nused;                    // Slabs integrated and written so far
+  long int nbadpos;                  // Cells not at the centre of their cell
+  int status;                        // 1 once a slab can not be read
+  pthread_mutex_t lock;
+  pthread_cond_t filled;             // Signalled when nread grows
+  pthread_cond_t freed;              // Signalled when nused grows
+};
+
+
+
+/*************************************************************************************
+NAME: stream_read_slab
+FUNCTION: Reads slab s into its slot of the ring
+INPUT: ring, slab
+RETURN: 0, 1 if the file ends or can not be read before the end of the slab
+*************************************************************************************/
+int stream_read_slab(struct stream_ring *ring, long int s)
+{
+  long int c0, nbad;
+  struct grid *slot;
+
+  c0 = s*ring->slab;
+  slot = &ring->slot[s % ring->nslots];
+  slot->col0 = c0;
+  slot->ncols = ring->ncolumns - c0 < ring->slab ? ring->ncolumns - c0 : ring->slab;
+  gread = slot;
+
+  report_begin(PHASE_READ);
+  if( GV.INPUT_FORMAT == INPUT_BINARY )
+    nbad = read_binary_cells(ring->inFile, c0*GV.NCELLS, slot->ncols*GV.NCELLS);
+  else
+    nbad = read_data_cells(ring->inFile, c0*GV.NCELLS, slot->ncols*GV.NCELLS);
+  report_end(PHASE_READ);
+
+  if( nbad < 0 )
+    {
+      printf("  * The file '%s' does not hold all the cells of the grid!\n", GV.FILENAME);
+      return 1;
+    }//if
+
+  ring->nbadpos += nbad;
+
+  return 0;
+}//stream_read_slab
+
+
+
+/*************************************************************************************
+NAME: stream_reader
+FUNCTION: Reader thread: fills the slots of the ring in order, waiting while all of
+them hold slabs that are not written yet. It stops at the first slab that can
+not be read, setting the status of the ring.
+INPUT: struct stream_ring
+RETURN: NULL
+*************************************************************************************/
+void *stream_reader(void *arg)
+{
+  int status;
+  long int s;
+  struct stream_ring *ring = (struct stream_ring *) arg;
+
+  for(s=0; s<ring->nslabs; s++)
+    {
+      pthread_mutex_lock(&ring->lock);
+      while( s - ring->nused >= ring->nslots )
+	pthread_cond_wait(&ring->freed, &ring->lock);
+      pthread_mutex_unlock(&ring->lock);
+
+      status = stream_read_slab(ring, s);
+
+      pthread_mutex_lock(&ring->lock);
+      ring->status = status;
+      ring->nread++;
+      pthread_cond_signal(&ring->filled);
+      pthread_mutex_unlock(&ring->lock);
+
+      if( status != 0 )
+	break;
+    }//for s
+
+  return NULL;
+}//stream_reader
+
+
+
+/*************************************************************************************
+NAME: stream_SW_maps
+FUNCTION: Reads, integrates and writes the grid one slab of columns at a time,
+with the reader thread STREAM_PREFETCH slabs ahead of the sweep. Without
+prefetching, or if the thread can not be started, every slab is read just
+before it is integrated. The sweep stops at the first slab that can not be
+read, the maps written so far are left as they are.
+INPUT: columns per slab (0 for one row of NCELLS columns)
+RETURN: 0, 1 if the data file can not be opened or read
+*************************************************************************************/
+int stream_SW_maps(long int slab)
+{
+  int n, threaded, status;
+  long int s;
+  char buff[1000];
+  FILE *pf[SW_OUTPUT_FILES];
+  pthread_t reader;
+  struct stream_ring ring;
+
+  ring.ncolumns = (long int) GV.NCELLS*GV.NCELLS;
+  if( slab <= 0 )
+    slab = GV.NCELLS;
+  if( slab > ring.ncolumns )
+    slab = ring.ncolumns;
+  ring.slab = slab;
+  ring.nslabs = (ring.ncolumns + slab - 1)/slab;
+
+  ring.nslots = GV.STREAM_PREFETCH + 1;
+  if( ring.nslots > STREAM_RING_MAX )
+    ring.nslots = STREAM_RING_MAX;
+  if( ring.nslots > ring.nslabs )
+    ring.nslots = ring.nslabs;
+  if( ring.nslots < 1 )
+    ring.nslots = 1;
+
+  /*+++ Input file, past its header +++*/
+  ring.inFile = input_open(GV.FILENAME);
+  if( ring.inFile == NULL )
+    {
+      printf("  * The file '%s' doesn't exist!\n", GV.FILENAME);
+      return 1;
+    }//if
+  setvbuf(ring.inFile, NULL, _IOFBF, STREAM_READ_BUFFER);
+
+  if( GV.INPUT_FORMAT == INPUT_BINARY )
+    fseek(ring.inFile, BINARY_HEADER_SIZE, SEEK_SET);
+  else if( fgets(buff, 1000, ring.inFile) == NULL )
+    printf("  * The file '%s' is empty!\n", GV.FILENAME);
+
+  /*+++ Memory for the slabs of the ring +++*/
+  report_begin(PHASE_ALLOC);
+  for(n=0; n<ring.nslots; n++)
+    {
+      if( grid_alloc(slab) != 0 )
+	{
+	  grid_free();
+	  for(n--; n>=0; n--)
+	    {
+	      gp = ring.slot[n];
+	      grid_free();
+	    }//for n
+	  fclose(ring.inFile);
+	  return 1;
+	}//if
+      ring.slot[n] = gp;
+    }//for n
+  sw_maps_alloc(slab);
+  report_end(PHASE_ALLOC);
+
+  printf("Streaming %ld columns per slab, %d slabs of %.3lf MB\n", slab, ring.nslots, gp.bytes/1048576.0);
+  printf("--------------------------------------------------\n");
+
+  /*+++ Output files +++*/
+  if( sw_output_open(pf) != 0 )
+    {
+      fclose(ring.inFile);
+      return 1;
+    }//if
+
+  /*+++ Reader thread, the ring needs at least one slot ahead +++*/
+  ring.nread = 0;
+  ring.nused = 0;
+  ring.nbadpos = 0;
+  ring.status = 0;
+  pthread_mutex_init(&ring.lock, NULL);
+  pthread_cond_init(&ring.filled, NULL);
+  pthread_cond_init(&ring.freed, NULL);
+
+  threaded = 0;
+  if( ring.nslots > 1 )
+    {
+      threaded = pthread_create(&reader, NULL, stream_reader, &ring) == 0;
+      if( !threaded )
+	printf("  * The reader thread could not be started, the slabs are read in turn\n");
+    }//if
+
+  /*+++ Slabs +++*/
+  report_progress_start(ring.ncolumns, "columns");
+  for(s=0; s<ring.nslabs; s++)
+    {
+      if( threaded )
+	{
+	  pthread_mutex_lock(&ring.lock);
+	  while( ring.nread <= s )
+	    pthread_cond_wait(&ring.filled, &ring.lock);
+	  status = ring.status;
+	  pthread_mutex_unlock(&ring.lock);
+	}//if
+      else
+	status = ring.status = stream_read_slab(&ring, s);
+
+      if( status != 0 )
+	break;
+
+      gp = ring.slot[s % ring.nslots];
+
+      report_begin(PHASE_INTEGRATE);
+      sweep_SW_maps();
+      report_end(PHASE_INTEGRATE);
+
+      report_begin(PHASE_OUTPUT);
+      sw_output_rows(pf);
+      report_end(PHASE_OUTPUT);
+
+      pthread_mutex_lock(&ring.lock);
+      ring.nused++;
+      pthread_cond_signal(&ring.freed);
+      pthread_mutex_unlock(&ring.lock);
+    }//for s
+  report_progress_end();
+
+  if( threaded )
+    pthread_join(reader, NULL);
+  gread = &gp;
+
+  pthread_cond_destroy(&ring.freed);
+  pthread_cond_destroy(&ring.filled);
+  pthread_mutex_destroy(&ring.lock);
+
+  sw_output_close(pf);
+  fclose(ring.inFile);
+
+  if( ring.status == 0 && ring.nbadpos > 0 )
+    printf("  * %ld cells are not at the centre (i+0.5)*CellSize assumed for the positions\n", ring.nbadpos);
+
+  sw_maps_free();
+  for(n=0; n<ring.nslots; n++)
+    {
+      gp = ring.slot[n];
+      grid_free();
+    }//for n
+
+  return ring.status;
+}//stream_SW_maps
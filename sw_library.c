@@ -0,0 +1,501 @@
+/****************************************************************************************************
+                       HEADERS
+****************************************************************************************************/
+#define _GNU_SOURCE //fopencookie, for the compressed data files
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <time.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_spline.h>
+#include <gsl/gsl_interp.h>
+#include <gsl/gsl_integration.h>
+#include <gsl/gsl_sort_float.h>
+#include "sw_library.h"
+
+
+/*************************************************************************************
+                           DEFINITION OF GLOBAL VARIABLES
+*************************************************************************************/
+double *z_depth=NULL, *PotDot=NULL, *PotDot_l_app1=NULL, *PotDot_l_app2=NULL;
+
+
+/*************************************************************************************
+                       INCLUDING SUPPORT FILES
+*************************************************************************************/
+#include "variables.c"
+#include "run_report.c"
+#include "grid_storage.c"
+#include "ascii_parser.c"
+#include "compressed_input.c"
+#include "reading.c"
+#include "mmap_reader.c"
+#include "column_interp.c"
+#include "simd_quadrature.c"
+#include "interp_PotDot_of_Z.c"
+#include "output_writer.c"
+#include "checkpoint.c"
+#include "column_sweep.c"
+#include "los_sweep.c"
+#include "sky_sweep.c"
+#include "mpi_decomposition.c"
+
+
+/*************************************************************************************
+                           LIBRARY CONTEXT
+*************************************************************************************/
+
+/*+++ State of one data file. The modules work on the globals GV, gp and SWF,
+      so a call copies the context into them and back when it is done. This
+      serializes the calls, the contexts are not reentrant. The library never
+      starts checkpoints (CKPT) nor the report at exit (report_start), and
+      never starts the pool of workspaces (WSPOOL); RUN and gread stay shared
+      by all the contexts. None of these globals is seen outside the
+      library, see 'make lib' +++*/
+struct sw_context
+{
+  struct GlobalVariables gv;          // Parameters and options
+  struct grid gp;                     // Grid of the whole box, or the mapped binary file
+  struct sw_field swf[MAX_SW_FIELDS]; // Registered fields and their maps
+  int nswfields;                      // Number of registered fields
+  void (*kernel)(struct simpson_plan *plan, double *fb, double *integ); // Batched Simpson kernel
+  int loaded;                         // 1 once sw_load has read the data file
+  long int nmap;                      // Values of each map, 0 before sw_integrate_maps
+  char error[256];                    // Last error of a call, "" if none
+};
+
+/*+++ Only one context at a time is in the globals +++*/
+static pthread_mutex_t sw_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/*************************************************************************************
+NAME: sw_fail
+FUNCTION: Keeps the message of an error of a call on a context, instead of
+printing it
+INPUT: context, printf format and its arguments
+RETURN: 1
+*************************************************************************************/
+static int sw_fail(sw_context *ctx, const char *format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(ctx->error, sizeof(ctx->error), format, args);
+  va_end(args);
+
+  return 1;
+}//sw_fail
+
+
+
+/*************************************************************************************
+NAME: sw_enter
+FUNCTION: Takes the lock and copies a context into the globals
+INPUT: context
+RETURN: none
+*************************************************************************************/
+static void sw_enter(sw_context *ctx)
+{
+  pthread_mutex_lock(&sw_lock);
+
+  GV = ctx->gv;
+  gp = ctx->gp;
+  memcpy(SWF, ctx->swf, sizeof(SWF));
+  NSWFIELDS = ctx->nswfields;
+  simpson_batch = ctx->kernel;
+}//sw_enter
+
+
+
+/*************************************************************************************
+NAME: sw_leave
+FUNCTION: Copies the globals back into a context and releases the lock
+INPUT: context
+RETURN: none
+*************************************************************************************/
+static void sw_leave(sw_context *ctx)
+{
+  ctx->gv = GV;
+  ctx->gp = gp;
+  memcpy(ctx->swf, SWF, sizeof(SWF));
+  ctx->nswfields = NSWFIELDS;
+  ctx->kernel = simpson_batch;
+
+  pthread_mutex_unlock(&sw_lock);
+}//sw_leave
+
+
+
+/*************************************************************************************
+NAME: sw_create
+FUNCTION: Allocates a context with the default options. The GSL error handler is
+turned off for the whole process, errors are returned instead of aborting.
+INPUT: None
+RETURN: context, NULL if it can not be allocated
+*************************************************************************************/
+sw_context *sw_create(void)
+{
+  sw_context *ctx=NULL;
+
+  ctx = (sw_context *) calloc(1, sizeof(sw_context));
+  if( ctx == NULL )
+    return NULL;
+
+  gsl_set_error_handler_off();
+
+  sw_enter(ctx);
+  default_run_options();
+  GV.RANK = 0;
+  GV.NPROCS = 1;
+  sw_leave(ctx);
+
+  return ctx;
+}//sw_create
+
+
+
+/*************************************************************************************
+NAME: sw_set
+FUNCTION: Sets one parameter as a line 'KEY = value' of the parameters file
+INPUT: context, key, value
+RETURN: 0, 1 if the key is unknown or the data is already loaded
+*************************************************************************************/
+int sw_set(sw_context *ctx, const char *key, const char *value)
+{
+  int status;
+  char k[100], v[1000];
+
+  ctx->error[0] = '\0';
+  if( ctx->loaded )
+    return sw_fail(ctx, "%s can not be changed once the data is loaded", key);
+
+  snprintf(k, sizeof(k), "%s", key);
+  snprintf(v, sizeof(v), "%s", value);
+
+  sw_enter(ctx);
+  status = set_parameter(parameter_trim(k), parameter_trim(v));
+  sw_leave(ctx);
+
+  if( status != 0 )
+    return sw_fail(ctx, "Unknown parameter '%s'", key);
+
+  return 0;
+}//sw_set
+
+
+
+/*************************************************************************************
+NAME: sw_read_parameters
+FUNCTION: Sets the parameters of a parameters file, the options it does not give
+go back to their default values
+INPUT: context, parameters file
+RETURN: 0, 1 if the file can not be read or the data is not defined
+*************************************************************************************/
+int sw_read_parameters(sw_context *ctx, const char *filename)
+{
+  int status;
+  char name[1000];
+
+  ctx->error[0] = '\0';
+  if( ctx->loaded )
+    return sw_fail(ctx, "The parameters can not be changed once the data is loaded");
+
+  snprintf(name, sizeof(name), "%s", filename);
+
+  sw_enter(ctx);
+  status = read_parameters(name);
+  sw_leave(ctx);
+
+  if( status != 0 )
+    return sw_fail(ctx, "The parameters file '%s' can not be read", filename);
+
+  return 0;
+}//sw_read_parameters
+
+
+
+/*************************************************************************************
+NAME: sw_load_data
+FUNCTION: Reads the whole data file into the globals with the same steps as the
+executable: detection of the format, binary header, registration of the data
+fields, allocation (or mapping) of the grid and reading. The grid is freed
+if the file can not be read.
+INPUT: None
+RETURN: 0, 1 if the data is not defined or can not be read
+*************************************************************************************/
+static int sw_load_data(void)
+{
+  int status;
+  long int ncols;
+
+  if( check_parameters() != 0 )
+    return 1;
+  derived_parameters();
+  column_interp_kind_check();
+  simpson_batch_select();
+  if( los_basis() != 0 )
+    return 1;
+
+  /*+++ The grid stays resident: no streaming, no dT/dr for the sky +++*/
+  GV.SWEEP_MODE = SWEEP_GRID;
+  if( GV.SKY_NSIDE > 0 )
+    GV.DT_DR_OUTPUT = 0;
+
+  if( GV.INPUT_FORMAT == INPUT_BINARY && read_binary_header() != 0 )
+    return 1;
+
+  NSWFIELDS = 0;
+  register_data_fields(GV.INPUT_FORMAT == INPUT_ASCII);
+
+  ncols = (long int) GV.NCELLS*GV.NCELLS;
+  if( GV.INPUT_FORMAT == INPUT_BINARY && GV.BINARY_READER == READER_MMAP )
+    return grid_map_binary(0, ncols);
+
+  if( grid_alloc(ncols) != 0 )
+    {
+      grid_free();
+      return 1;
+    }//if
+  gp.col0 = 0;
+
+  if( GV.INPUT_FORMAT == INPUT_BINARY )
+    status = read_binary(GV.FILENAME);
+  else
+    status = read_data(GV.FILENAME);
+
+  if( status != 0 )
+    grid_free();
+
+  return status;
+}//sw_load_data
+
+
+
+/*************************************************************************************
+NAME: sw_load
+FUNCTION: Reads the data file into the context, where it stays until sw_free
+INPUT: context
+RETURN: 0, 1 if the data is not defined or can not be read
+*************************************************************************************/
+int sw_load(sw_context *ctx)
+{
+  int status;
+
+  ctx->error[0] = '\0';
+  if( ctx->loaded )
+    return 0;
+
+  sw_enter(ctx);
+  status = sw_load_data();
+  ctx->loaded = status == 0;
+  sw_leave(ctx);
+
+  if( status != 0 )
+    return sw_fail(ctx, "The data file '%s' can not be read", ctx->gv.FILENAME);
+
+  return 0;
+}//sw_load
+
+
+
+/*************************************************************************************
+NAME: sw_integrate_maps
+FUNCTION: Integrates the maps of all the fields: the columns along LOS, or the
+pixels of the full sky with SKY_NSIDE > 0. Earlier maps are replaced.
+INPUT: context
+RETURN: 0, 1 if the data is not loaded
+*************************************************************************************/
+int sw_integrate_maps(sw_context *ctx)
+{
+  ctx->error[0] = '\0';
+  if( !ctx->loaded )
+    return sw_fail(ctx, "The data must be loaded before the maps are integrated");
+
+  sw_enter(ctx);
+
+  sw_maps_free();
+  if( GV.SKY_NSIDE > 0 )
+    {
+      ctx->nmap = 12*GV.SKY_NSIDE*GV.SKY_NSIDE;
+      sw_maps_alloc(ctx->nmap);
+      sweep_SW_sky();
+    }//if
+  else
+    {
+      ctx->nmap = gp.ncols;
+      sw_maps_alloc(ctx->nmap);
+      if( los_along_z() )
+	sweep_SW_maps();
+      else
+	sweep_SW_los();
+    }//else
+
+  sw_leave(ctx);
+
+  return 0;
+}//sw_integrate_maps
+
+
+
+/*************************************************************************************
+NAME: sw_integrate_column
+FUNCTION: Integrates the column (i,j) along z for all the fields, without touching
+the maps
+INPUT: context, column (i,j), values and errors (or NULL) of NSWFIELDS fields
+RETURN: 0, 1 if the data is not loaded or (i,j) is outside the grid
+*************************************************************************************/
+int sw_integrate_column(sw_context *ctx, int i, int j, double *values, double *errors)
+{
+  int f;
+  struct column_workspace ws;
+
+  ctx->error[0] = '\0';
+  if( !ctx->loaded )
+    return sw_fail(ctx, "The data must be loaded before a column is integrated");
+  if( i < 0 || j < 0 || i >= ctx->gv.NCELLS || j >= ctx->gv.NCELLS )
+    return sw_fail(ctx, "The column (%d,%d) is outside the grid of N=%d", i, j, ctx->gv.NCELLS);
+
+  sw_enter(ctx);
+
+  column_workspace_alloc(&ws, GV.NCELLS);
+  gather_column(&ws, i, j);
+  for(f=0; f<NSWFIELDS; f++)
+    {
+      build_column(&ws, f);
+      values[f] = GV.a_SF*integrate_column(&ws.ci, 0.0, SWF[f].zmax, &SWF[f].CheckMaxDiff);
+      if( errors != NULL )
+	errors[f] = GV.INTEG_MODE == INTEG_ADAPTIVE ? GV.a_SF*ws.ci.error : 0.0;
+    }//for f
+  column_workspace_free(&ws);
+
+  sw_leave(ctx);
+
+  return 0;
+}//sw_integrate_column
+
+
+
+/*************************************************************************************
+NAME: sw_nfields, sw_field_name, sw_map, sw_map_error
+FUNCTION: Registered fields and their maps
+INPUT: context, index of the field, number of values of the map (or NULL)
+RETURN: number of fields, name, map or errors (NULL if there are none)
+*************************************************************************************/
+int sw_nfields(sw_context *ctx)
+{
+  return ctx->nswfields;
+}//sw_nfields
+
+
+const char *sw_field_name(sw_context *ctx, int f)
+{
+  if( f < 0 || f >= ctx->nswfields )
+    return NULL;
+
+  return ctx->swf[f].name;
+}//sw_field_name
+
+
+const double *sw_map(sw_context *ctx, int f, long int *n)
+{
+  if( f < 0 || f >= ctx->nswfields )
+    return NULL;
+
+  if( n != NULL )
+    *n = ctx->swf[f].SW_map != NULL ? ctx->nmap : 0;
+
+  return ctx->swf[f].SW_map;
+}//sw_map
+
+
+const double *sw_map_error(sw_context *ctx, int f)
+{
+  if( f < 0 || f >= ctx->nswfields )
+    return NULL;
+
+  return ctx->swf[f].SW_err;
+}//sw_map_error
+
+
+
+/*************************************************************************************
+NAME: sw_write_maps
+FUNCTION: Writes the maps in the OUTPUT format to the files of the executable
+INPUT: context
+RETURN: 0, 1 if there are no maps or a file can not be written
+*************************************************************************************/
+int sw_write_maps(sw_context *ctx)
+{
+  int status;
+
+  ctx->error[0] = '\0';
+  if( ctx->nmap == 0 )
+    return sw_fail(ctx, "There are no maps to write");
+
+  sw_enter(ctx);
+  if( GV.SKY_NSIDE > 0 )
+    status = write_sky_maps();
+  else
+    status = mpi_output_maps();
+  sw_leave(ctx);
+
+  if( status != 0 )
+    return sw_fail(ctx, "The maps can not be written");
+
+  return 0;
+}//sw_write_maps
+
+
+
+/*************************************************************************************
+NAME: sw_error
+FUNCTION: Message of the last error of a call on a context
+INPUT: context
+RETURN: message, "" if the last call did not fail
+*************************************************************************************/
+const char *sw_error(sw_context *ctx)
+{
+  return ctx->error;
+}//sw_error
+
+
+
+/*************************************************************************************
+NAME: sw_free
+FUNCTION: Frees the maps, the grid and the context
+INPUT: context
+RETURN: none
+*************************************************************************************/
+void sw_free(sw_context *ctx)
+{
+  if( ctx == NULL )
+    return;
+
+  sw_enter(ctx);
+  sw_maps_free();
+  grid_free();
+  sw_leave(ctx);
+
+  free(ctx);
+}//sw_free
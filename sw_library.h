@@ -0,0 +1,81 @@
+/******************************************************************************
+NAME: sw_library
+FUNCTION: Serialized library interface of the SW integrator. A context owns
+the parameters, the grid, the registered fields and their maps of one data
+file, so several snapshots can stay loaded in one process and be
+integrated on request. The integrator works on process-wide globals, so
+the contexts are not reentrant: every call copies its context into the
+globals and back under one lock. Calls on any contexts may come from any
+threads, but they run one at a time, each one with all the OpenMP
+threads, and sw_load blocks the other contexts until its file is read.
+The run report counters are shared by all the contexts. The library
+returns its errors, see sw_error, but the reading and integration steps
+still print their progress and warnings to stdout.
+Build with 'make lib' (libswintegral.a and libswintegral.so) and link
+with -lswintegral -lgsl -lgslcblas -lz -lm -fopenmp. Both export only
+the sw_* functions, the globals and functions of the integrator are
+local to the library.
+INPUT: Parameters as in the parameters file
+RETURN: Maps and column integrals of the data fields
+******************************************************************************/
+#ifndef SW_LIBRARY_H
+#define SW_LIBRARY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define SW_API __attribute__((visibility("default")))
+#else
+#define SW_API
+#endif
+
+typedef struct sw_context sw_context;
+
+/*+++ Context with the default options, NULL if it can not be allocated +++*/
+SW_API sw_context *sw_create(void);
+
+/*+++ One 'KEY = value' of the parameters file (N, FILENAME, FORMAT, INTEGRATION, ...).
+      0, 1 if the key is unknown or the data is already loaded +++*/
+SW_API int sw_set(sw_context *ctx, const char *key, const char *value);
+
+/*+++ All the keys of a parameters file. 0, 1 if it can not be read +++*/
+SW_API int sw_read_parameters(sw_context *ctx, const char *filename);
+
+/*+++ Reads the data file into the context, which keeps it until sw_free.
+      0, 1 if the data is not defined or can not be read +++*/
+SW_API int sw_load(sw_context *ctx);
+
+/*+++ Maps of all the fields: NCELLS^2 columns along LOS, or 12 SKY_NSIDE^2
+      pixels of the full sky. 0, 1 if the data is not loaded +++*/
+SW_API int sw_integrate_maps(sw_context *ctx);
+
+/*+++ a_SF times the integral along z of column (i,j) for every field, and its
+      estimated error in adaptive mode (errors may be NULL). 0, 1 if the data
+      is not loaded or (i,j) is outside the grid +++*/
+SW_API int sw_integrate_column(sw_context *ctx, int i, int j, double *values, double *errors);
+
+/*+++ Registered fields, filled by sw_load +++*/
+SW_API int sw_nfields(sw_context *ctx);
+SW_API const char *sw_field_name(sw_context *ctx, int f);
+
+/*+++ Map of field f and its number of values, NULL before sw_integrate_maps.
+      sw_map_error is NULL unless INTEGRATION = adaptive +++*/
+SW_API const double *sw_map(sw_context *ctx, int f, long int *n);
+SW_API const double *sw_map_error(sw_context *ctx, int f);
+
+/*+++ Writes the maps as the executable does, in the OUTPUT format. 0, 1 on error +++*/
+SW_API int sw_write_maps(sw_context *ctx);
+
+/*+++ Message of the last error of a call on the context, "" if none +++*/
+SW_API const char *sw_error(sw_context *ctx);
+
+/*+++ Frees the grid, the maps and the context +++*/
+SW_API void sw_free(sw_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -34,17 +34,63 @@ Gravitational constant in the interal units G = 43.0071
                             STRUCTURES
 ******************************************************************/
 
+#define MAX_SW_FIELDS 16 //Maximum number of fields in the column sweep registry
+#define SW_NAME_LEN 32   //Length of the names of the fields, also in the binary output
+#define GRID_POTDOT 0        //Potential's time derivative (exact solution)
+#define GRID_POTDOT_L_APP1 1 //Potential's time derivative in the first linear approximation
+#define GRID_POTDOT_L_APP2 2 //Potential's time derivative in the second linear approximation
+#define GRID_NFIELDS 3       //Number of fields the grid can hold
+#define BINARY_HEADER_SIZE (5*sizeof(double)) //BoxSize, Omega_M0, Omega_L0, z_RS, H0
+#define BINARY_RECORD_SIZE (sizeof(int) + 7*sizeof(double)) //GID, pos[3], DenCon, Pot, PotDot_l_app1, PotDot_l_app2
+#define BINARY_OFFSET_L_APP1 (sizeof(int) + 5*sizeof(double)) //PotDot_l_app1 inside a record
+#define BINARY_OFFSET_L_APP2 (sizeof(int) + 6*sizeof(double)) //PotDot_l_app2 inside a record
+#define BINARY_READ_BLOCK 65536 //Records read with each fread
+#define STREAM_RING_MAX 16 //Largest number of slabs in the ring of the streaming sweep
+#define STREAM_READ_BUFFER (8*1024*1024) //stdio buffer of the data file when streaming
+#define INPUT_BUFFER (16*1024*1024) //Compressed bytes of the data file read at a time
+#define INPUT_CHUNK (1024*1024) //Bytes decompressed at a time from frames that are not independent
+#define INPUT_FRAMES 256 //Independent frames (BGZF blocks, zstd frames) decompressed in parallel at a time
+#define INPUT_FRAME_MAX (64*1024*1024) //Largest decompressed bytes of a batch of frames
+#define SIMD_BATCH 8 //Columns integrated in lockstep by the batched Simpson kernel
+#define RAY_BUNDLE 8 //Rays per side of the bundles stepping together along a line of sight
+#define SKY_CHUNK 64 //Pixels handed to a thread at a time in the full-sky sweep
+#define PHASE_PARAMETERS 0 //Reading of the parameters file
+#define PHASE_ALLOC 1      //Allocation or mapping of the grid and the maps
+#define PHASE_READ 2       //Reading of the data file
+#define PHASE_INTEGRATE 3  //Interpolation and integration of the columns, rays or pixels
+#define PHASE_OUTPUT 4     //Writing of the maps
+#define NPHASES 5
+#define REPORT_MAX_THREADS 256 //Threads with their own busy time in the run report
+#define POOL_MAX_THREADS 256 //Threads with a workspace kept between sweeps, the others allocate their own
+
+/*+++ Values of one field for all the cells: cell m is at base + m*stride.
+      Arrays in memory have stride sizeof(double), or sizeof(float) with
+      STORAGE = float, the packed records of a memory-mapped binary file
+      have stride BINARY_RECORD_SIZE +++*/
+struct field_view
+{
+  char *base;      // Address of the value of cell 0
+  size_t stride;   // Bytes between the values of consecutive cells
+  int single;      // 1 if the values are floats, 0 if they are doubles
+};
+
+
+/*+++ Grid stored as a structure of arrays. Only the fields requested for the
+      run are allocated, each one contiguous with k running fastest, so every
+      (i,j) column is a unit-stride run of NCELLS values. Cell positions are
+      not stored, they are derived from (i,j,k) with GRID_POS() +++*/
 struct grid
 {
-  int GID;           // Gid; Cell ID (m)
-  double pos[3];     //Cell position
-  double p[3];     //momentum in each direction
-  double NumDen;    //Density of each cell
-  double DenCon;     //Density contrast value in the cell
-  double potDot_r;   //Potential's time derivative (exact solution)
-  double potDot_r_l_app1; //Potential's time deriative in r-space in the linear approximation.
-  double potDot_r_l_app2; //Potential's time deriative in r-space in the linear approximation.
-}*gp; //grid
+  int requested[GRID_NFIELDS]; // 1 if the field is needed by the run
+  void *field[GRID_NFIELDS];   // field[f][INDEX_C_ORDER(i,j,k) - col0*NCELLS], doubles or floats, NULL if not requested
+  struct field_view view[GRID_NFIELDS]; // How the sweep reads each field: field[] or a mapped file
+  long int col0;               // First column (i*NCELLS + j) held by the grid
+  long int ncols;              // Number of columns held: NCELLS^2, or a slab when streaming
+  size_t bytes;                // Memory allocated for the fields
+  char *map;                   // Memory-mapped binary file, NULL if the file was read
+  size_t mapbytes;             // Length of the mapping
+}gp; //grid
+struct grid *gread = &gp; // Grid filled by the readers: gp, or the next buffer in batch mode
 
 
 struct GlobalVariables
@@ -54,7 +100,7 @@ struct GlobalVariables
   /*+++ Grid constants +++*/
   double BoxSize;      // Size of the simulation box in one axis (all must be the same)
   int NCELLS;       // Number of cells in one axis
-  int NTOTALCELLS;  // Total number of cell
+  long int NTOTALCELLS;  // Total number of cell
   
   double Mpart;     // Mass of the particles
   double CellSize;  // Size of the cell
@@ -72,9 +118,152 @@ struct GlobalVariables
   double MeanDen; // MeanDens;= 7.160809 Units *1E10 M_Sun/h
   double c_SL; // Speed of light 300000 km/s
   double CMB_T0; //Mean temperature of CMB in K
+
+  /*+++ Integration +++*/
+  int INPUT_FORMAT;    // INPUT_ASCII or INPUT_BINARY, INPUT_AUTO until the data file is detected
+  int BINARY_READER;   // READER_FREAD or READER_MMAP
+  int SWEEP_MODE;      // SWEEP_GRID (whole grid in memory) or SWEEP_STREAM (slabs of columns)
+  long int STREAM_COLUMNS; // Columns per slab in SWEEP_STREAM mode
+  int STREAM_PREFETCH; // Slabs read ahead by the reader thread in SWEEP_STREAM mode, 0 to read them in turn
+  int OUTPUT_FORMAT;   // OUTPUT_ASCII (one file per field) or OUTPUT_BINARY (BINARY_OUTPUT_FILE)
+  char OUTPUT_PREFIX[1000]; // Directory and start of the names of the output files, "./" if empty
+  int DT_DR_OUTPUT;    // 1 to write the 3D dT/dr of every registered field
+  double CHECKPOINT;   // Seconds between checkpoints of the maps, 0 for none
+  int RESTART;         // 1 to go on from the checkpoint of an earlier run
+  int INTEG_MODE;      // INTEG_SIMPSON, INTEG_EXACT or INTEG_CHECK (both, reporting differences)
+  int SIMD_MODE;       // Batched Simpson kernel: SIMD_AUTO, SIMD_SCALAR, SIMD_AVX2 or SIMD_AVX512
+  int INTERP_KIND;     // Interpolation of PotDot(z): INTERP_LINEAR, INTERP_CSPLINE, INTERP_AKIMA or INTERP_STEFFEN
+  int STORAGE;         // Grid values: STORAGE_DOUBLE, STORAGE_FLOAT or STORAGE_CHECK (double, reporting the float differences)
+  double LOS[3];       // Line of sight of the maps (normalised), the z axis by default
+  double LOS_U[3];     // First axis of the plane of the maps, perpendicular to LOS
+  double LOS_V[3];     // Second axis of the plane of the maps, LOS x LOS_U
+  long int SKY_NSIDE;  // NSIDE of the full-sky HEALPix maps, 0 for the maps of the box
+  double OBSERVER[3];  // Position of the observer of the full-sky maps
+  double RMAX;         // Comoving distance reached by the rays of the full-sky maps
+  double IntegCheckMaxDiff; // Largest |exact - simpson| found in INTEG_CHECK mode
+  double EPSABS;       // Absolute tolerance of the adaptive quadrature
+  double EPSREL;       // Relative tolerance of the adaptive quadrature
+
+  /*+++ Processes +++*/
+  int RANK;            // MPI rank of this process, 0 without MPI
+  int NPROCS;          // Processes sharing the columns of the grid, 1 without MPI
 }GV;//globalVariables
 
 
+/*+++ Interpolant of one (i,j) column, built once and sampled many times +++*/
+struct column_interp
+{
+  int nknots;               // Number of knots in the column (GV.NCELLS)
+  double *z;                // Knot positions, points to the caller's column buffer
+  double *f;                // Knot values, points to the caller's column buffer
+  gsl_interp_accel *acc;    // Accelerator, kept warm between consecutive samples
+  gsl_spline *spline;       // GSL spline of kind GV.INTERP_KIND, allocated once and re-initialised per column
+  int kind;                 // INTERP_LINEAR (GSL evaluation) or a cubic kind (coefficient table)
+  int cache;                // Segment of the last evaluation from the table
+  double *coef;             // Cubic of each segment, coef[4*k + p] times (z - z[k])^p, NULL if linear
+  gsl_integration_workspace *qag; // Workspace of the adaptive quadrature, allocated on first use
+  double *pts;              // Breakpoints of the adaptive quadrature, nknots+2
+  double error;             // Error estimated by the last adaptive integral
+  int status;               // GSL status of the last adaptive integral
+  long int nevals;          // Values computed by the Simpson and adaptive integrals, added to RUN.evals when freed
+  int compensated;          // 1 to add up the Simpson and closed-form integrals with Kahan sums
+}PotDot_interp, PotDot_l_app1_interp, PotDot_l_app2_interp; //column interpolants
+
+
+/*+++ Samples of the Simpson rule on the knots shared by all the columns of a field +++*/
+struct simpson_plan
+{
+  int nsamples;   // Number of samples, Nsamples+1, ordered x0, even, odd, xn
+  int neven;      // Number of even samples, between x0 and the odd ones
+  int *k;         // Knot interval of each sample, z[k] <= x < z[k+1]
+  double *t;      // Position of each sample in its interval, (x - z[k])/(z[k+1] - z[k])
+  double hstep;   // Width of the Simpson intervals
+};
+
+
+/*+++ Per-thread buffers used to gather and integrate one column +++*/
+struct column_workspace
+{
+  double *z_depth;           // Positions in z of the column
+  double *PotDot;            // Values along the column of every registered field, NSWFIELDS*NCELLS
+  double *T_depth;           // Depth profile of the column for the dT/dr output
+  double *batch;             // SIMD_BATCH columns interleaved, batch[(f*NCELLS + k)*SIMD_BATCH + lane]
+  struct column_interp ci;   // Interpolant built on z_depth and one field of PotDot
+};
+
+
+/*+++ Workspaces kept by the threads from one sweep to the next, see column_workspace_take +++*/
+struct workspace_pool
+{
+  int active;                                   // 1 while the workspaces are kept (batch, streaming)
+  int ready[POOL_MAX_THREADS];                  // 1 once the workspace of the thread is allocated
+  struct column_workspace ws[POOL_MAX_THREADS]; // Workspace of each thread
+}WSPOOL; //pool of workspaces
+
+
+/*+++ Registry of the grid fields integrated by the column sweep +++*/
+struct sw_field
+{
+  char name[SW_NAME_LEN]; // Name of the field
+  int field;             // Grid field to integrate (GRID_*)
+  double zmax;           // Last knot of the column and upper limit of the integral
+  char outfile[1000];    // Output file of the SW map
+  char header[1000];     // First line of the output file
+  char rowformat[100];   // fprintf format of the rows: n, i, j, x, y, SW_Integral
+  char errformat[120];   // rowformat with the estimated error as a last column
+  double CheckMaxDiff;   // Largest |exact - simpson| difference in INTEG_CHECK mode
+  double StorageMaxDiff; // Largest |double - float| difference of SW_map in STORAGE_CHECK mode
+  struct simpson_plan plan; // Simpson samples between 0 and zmax, nsamples=0 if not built
+  double *SW_map;        // a_SF times the SW integral of each column, SW_map[i*NCELLS + j]
+  double *dT_dr;         // dT/dr of each cell of the columns in SW_map, NULL without DT_DR output
+  double *SW_err;        // a_SF times the estimated error of each SW_map value, NULL if not adaptive
+  double MaxError;       // Largest value of SW_err
+  long int NFailed;      // Columns where the adaptive quadrature did not reach the tolerance
+}SWF[MAX_SW_FIELDS]; //registered fields
+int NSWFIELDS = 0;     // Number of registered fields
+int NREADTHREADS = 0;  // Threads of the parallel readers, 0 for all (see read_threads)
+
+
+/*+++ Timers and counters of the run, see run_report.c +++*/
+struct run_report
+{
+  double start;                  // Time at the beginning of the run
+  double phase_seconds[NPHASES]; // Time spent in each phase
+  double phase_start[NPHASES];   // Beginning of the current call of each phase
+  long int phase_calls[NPHASES]; // Times each phase was entered (once per slab when streaming)
+  long int bytes_read;           // Bytes of the data file read
+  long int bytes_mapped;         // Bytes of the data file mapped, read in place by the sweep
+  long int bytes_written;        // Bytes of maps and dT/dr written
+  long int evals;                // Values of the column interpolants computed
+  long int columns;              // Columns, rays or pixels integrated
+  double busy[REPORT_MAX_THREADS]; // Time each thread spent working in the parallel sweeps
+  char progress_what[32];        // Units of the running progress, "" if none
+  long int progress_total;       // Units to do
+  long int progress_done;        // Units done
+  double progress_start;         // Time at the beginning of the progress
+  double progress_last;          // Time of the last progress line
+}RUN; //run report
+
+
+/*+++ Columns done since the beginning of the run, see checkpoint.c +++*/
+struct checkpoint
+{
+  unsigned char *done; // 1 for the columns (rays, pixels) whose maps are complete, NULL without checkpoints
+  long int nunits;     // Columns (rays, pixels) of the maps
+  double last;         // Time of the last checkpoint
+  int writing;         // 1 while a thread writes the checkpoint
+}CKPT; //checkpoint of the maps
+
+
+/*+++ Pixel of the full-sky maps with the Morton key of its direction +++*/
+struct sky_order
+{
+  unsigned long long int key; // Morton key of the direction
+  long int pix;               // Pixel in RING ordering
+};
+void (*simpson_batch)(struct simpson_plan *plan, double *fb, double *integ) = NULL; // Batched Simpson kernel, see simpson_batch_select
+
+
 struct aux_grid
 {
   double auxPos[2]; //position in x,y for the columns
@@ -94,5 +283,44 @@ struct aux_grid
 #define Y 1
 #define Z 2
 #define INTEGRATION_NSTEPS 10000
-#define INDEX_C_ORDER(i,j,k) (k)+GV.NCELLS*((j)+GV.NCELLS*(i)) //Index in C-order
-#define INDEX_C_2D(i,j) GV.NCELLS*((j)+GV.NCELLS*(i))
+#define INTEG_SIMPSON 0 //Simpson rule with INTEGRATION_NSTEPS intervals
+#define INTEG_EXACT 1   //Closed-form integral of the interpolant
+#define INTEG_CHECK 2   //Both, the closed form is returned and compared with Simpson
+#define INTEG_ADAPTIVE 3 //Adaptive Gauss-Kronrod (QAGP) with the knots as breakpoints
+#define ADAPTIVE_LIMIT 1000 //Subintervals of the adaptive quadrature besides the knots
+#define INTERP_LINEAR 0  //Linear interpolation of PotDot(z)
+#define INTERP_CSPLINE 1 //Natural cubic spline
+#define INTERP_AKIMA 2   //Akima spline, less prone to overshoot than the cubic spline
+#define INTERP_STEFFEN 3 //Steffen spline, monotone between the knots
+#define INPUT_ASCII 0   //Data file with one line of text per cell
+#define INPUT_BINARY 1  //Data file with a header and one packed record per cell
+#define INPUT_AUTO 2    //Format detected from the first bytes of the data file
+#define READER_FREAD 0  //Binary file copied into the grid with fread
+#define READER_MMAP 1   //Binary file memory-mapped and read in place
+#define SWEEP_GRID 0    //The whole grid is read before the columns are integrated
+#define SWEEP_STREAM 1  //Slabs of columns are read, integrated, written and dropped
+#define OUTPUT_ASCII 0  //One formatted file per field
+#define OUTPUT_BINARY 1 //Header and dense float64 maps of all the fields in one file
+#define SIMD_AUTO 0     //Widest batched Simpson kernel supported by the CPU
+#define SIMD_SCALAR 1   //Portable batched Simpson kernel
+#define SIMD_AVX2 2     //Batched Simpson kernel with AVX2, two registers of 4 columns
+#define SIMD_AVX512 3   //Batched Simpson kernel with AVX-512, one register of 8 columns
+#define STORAGE_DOUBLE 0 //Grid values stored as doubles
+#define STORAGE_FLOAT 1  //Grid values stored as floats, the integrals added up with Kahan sums
+#define STORAGE_CHECK 2  //Doubles, every column integrated again from its values rounded to float
+#define COMPRESS_NONE 0  //Plain data file
+#define COMPRESS_GZIP 1  //gzip data file, BGZF blocks decompressed in parallel
+#define COMPRESS_ZSTD 2  //zstd data file (HAVE_ZSTD), frames with their size decompressed in parallel
+#define BINARY_OUTPUT_FILE "./SW_Integral_maps.bin"
+#define SKY_OUTPUT_FILE "./ISW_sky_maps.bin"
+#define BATCH_PREFIX "./snapshot_%03d_" //OUTPUT_PREFIX of the snapshots of a batch that do not set it
+#define BATCH_READ_THREADS 2 //Threads of the parallel readers while a snapshot is integrated in batch mode
+#define RUN_REPORT_FILE "./run_report" //JSON summary of the run, .json or _<rank>.json with several processes
+#define REPORT_INTERVAL 10.0 //Seconds between progress lines
+#define CHECKPOINT_FILE "./SW_checkpoint" //Checkpoint of the maps, .bin or _<rank>.bin with several processes
+#define BINARY_OUTPUT_BUFFER (8*1024*1024) //stdio buffer of the binary output
+#define SW_OUTPUT_FILES (2*MAX_SW_FIELDS) //Maps of the fields, then their dT/dr
+#define SWEEP_CHUNK 16 //Columns handed to a thread at a time in the column sweep
+#define INDEX_C_ORDER(i,j,k) (k)+(long int)GV.NCELLS*((j)+(long int)GV.NCELLS*(i)) //Index in C-order
+#define INDEX_C_2D(i,j) (long int)GV.NCELLS*((j)+(long int)GV.NCELLS*(i))
+#define GRID_POS(i) (((i) + 0.5)*GV.CellSize) //Position of the centre of cell i along one axis